@@ -0,0 +1,115 @@
+#include "SusParser.h"
+#include "File.h"
+#include "IO.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <numeric>
+#include <random>
+
+namespace MikuMikuWorld
+{
+	// Defined in SusParserLinearBars.cpp
+	SUS parseSusLinearBars(const std::string& filename);
+}
+
+using namespace MikuMikuWorld;
+
+constexpr int benchmarkMeasures = 4000;
+constexpr int notesPerMeasure = 8;
+constexpr int cellsPerMeasure = 16;
+constexpr int benchmarkRuns = 5;
+
+// A time signature change on every measure followed by one line of taps per measure
+static std::string generateSus()
+{
+	constexpr float beats[]{ 2.0f, 2.5f, 3.0f, 4.0f, 7.0f };
+	std::mt19937 random(2024);
+	std::string text = "#REQUEST \"ticks_per_beat 480\"\n#BPM01: 120\n#00008: 01\n";
+
+	for (int measure = 0; measure < benchmarkMeasures; ++measure)
+	{
+		if (measure % 1000 == 0)
+			text.append(IO::formatString("#MEASUREBS %d\n", measure));
+
+		float length = beats[random() % std::size(beats)];
+		text.append(IO::formatString("#%03d02: %g\n", measure % 1000, length));
+	}
+
+	std::array<int, cellsPerMeasure> cells{};
+	std::iota(cells.begin(), cells.end(), 0);
+	for (int measure = 0; measure < benchmarkMeasures; ++measure)
+	{
+		if (measure % 1000 == 0)
+			text.append(IO::formatString("#MEASUREBS %d\n", measure));
+
+		std::string data(cellsPerMeasure * 2, '0');
+		std::shuffle(cells.begin(), cells.end(), random);
+		for (int i = 0; i < notesPerMeasure; ++i)
+		{
+			data[cells[i] * 2 + 0] = '1';
+			data[cells[i] * 2 + 1] = '2' + random() % 2;
+		}
+
+		char lane = "23456789ab"[random() % 10];
+		text.append(IO::formatString("#%03d1%c:%s\n", measure % 1000, lane, data.c_str()));
+	}
+
+	return text;
+}
+
+template <typename Parse>
+static double timeParse(const std::string& filename, Parse parse, SUS& result)
+{
+	double best = std::numeric_limits<double>::max();
+	for (int run = 0; run < benchmarkRuns; ++run)
+	{
+		auto start = std::chrono::steady_clock::now();
+		result = parse(filename);
+		auto end = std::chrono::steady_clock::now();
+
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	return best;
+}
+
+static bool sameNotes(const std::vector<SUSNote>& a, const std::vector<SUSNote>& b)
+{
+	return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+	                  [](const SUSNote& n1, const SUSNote& n2)
+	                  {
+		                  return n1.tick == n2.tick && n1.lane == n2.lane && n1.width == n2.width &&
+		                         n1.type == n2.type;
+	                  });
+}
+
+// Times SusParser::parse on a chart with many #xxx02 lines, with the cumulative bar
+// table and with the previous linear lookup. Pass a path to choose where the chart is written
+int main(int argc, char** argv)
+{
+	std::string filename = argc > 1 ? argv[1] : "SusParserBenchmark.sus";
+
+	IO::File file(IO::mbToWideStr(filename), L"wb");
+	file.write(generateSus());
+	file.close();
+
+	SUS cumulative, linear;
+	double cumulativeTime =
+	    timeParse(filename, [](const std::string& f) { return SusParser().parse(f); }, cumulative);
+	double linearTime = timeParse(filename, parseSusLinearBars, linear);
+
+	printf("%zu bar lengths, %zu notes\n", cumulative.barlengths.size(), cumulative.taps.size());
+	printf("cumulative bar table: %.2f ms\n", cumulativeTime);
+	printf("linear bar lookup:    %.2f ms\n", linearTime);
+
+	if (!sameNotes(cumulative.taps, linear.taps))
+	{
+		printf("The parsed notes differ\n");
+		return 1;
+	}
+
+	return 0;
+}
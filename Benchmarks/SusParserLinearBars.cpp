@@ -0,0 +1,14 @@
+// Builds the parser a second time with the linear bar length lookup it used before the
+// cumulative bar table, under another class name so both can be timed in one program
+#define SUS_PARSER_LINEAR_BAR_LOOKUP
+#define SusParser SusParserLinearBars
+#include "SusParser.cpp"
+
+namespace MikuMikuWorld
+{
+	SUS parseSusLinearBars(const std::string& filename)
+	{
+		SusParser parser;
+		return parser.parse(filename);
+	}
+}
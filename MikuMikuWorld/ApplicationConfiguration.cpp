@@ -93,6 +93,9 @@ namespace MikuMikuWorld
 			autoSaveMaxCount = jsonIO::tryGetValue<int>(config["save"], "auto_save_max_count", 100);
 		}
 
+		if (jsonIO::keyExists(config, "history"))
+			historyMemoryLimit = jsonIO::tryGetValue<int>(config["history"], "memory_limit", 256);
+
 		if (jsonIO::keyExists(config, "audio"))
 		{
 			seProfileIndex = jsonIO::tryGetValue<int>(config["audio"], "se_profile", 0);
@@ -179,6 +182,8 @@ namespace MikuMikuWorld
 			               { "auto_save_interval", autoSaveInterval },
 			               { "auto_save_max_count", autoSaveMaxCount } };
 
+		config["history"] = { { "memory_limit", historyMemoryLimit } };
+
 		config["audio"] = {
 			{"se_profile", seProfileIndex},
 			{"master_volume", masterVolume},
@@ -241,6 +246,7 @@ namespace MikuMikuWorld
 		autoSaveEnabled = true;
 		autoSaveInterval = 5;
 		autoSaveMaxCount = 100;
+		historyMemoryLimit = 256;
 
 		seProfileIndex = 0;
 		masterVolume = 1.0f;
@@ -91,6 +91,7 @@ namespace MikuMikuWorld
 		bool autoSaveEnabled;
 		int autoSaveInterval;
 		int autoSaveMaxCount;
+		int historyMemoryLimit;
 		float masterVolume;
 		float bgmVolume;
 		float seVolume;
@@ -1,13 +1,52 @@
 #include "BinaryReader.h"
 #include "IO.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 
 namespace IO
 {
-	BinaryReader::BinaryReader(const std::string& filename)
+	BinaryReader::BinaryReader(const std::string& filename, bool partial)
+	    : stream{ NULL }, data{ nullptr }, size{ 0 }, origin{ 0 }, position{ 0 }, fileSize{ 0 },
+	      valid{ false }
 	{
-		stream = NULL;
 		std::wstring wFilename = mbToWideStr(filename);
 		stream = _wfopen(wFilename.c_str(), L"rb");
+		if (!stream)
+			return;
+
+		fseek(stream, 0, SEEK_END);
+		long length = ftell(stream);
+		if (length < 0)
+		{
+			close();
+			return;
+		}
+
+		fileSize = length;
+		valid = true;
+		if (!partial)
+		{
+			buffer.resize(fileSize);
+			fseek(stream, 0, SEEK_SET);
+			valid = fread(buffer.data(), 1, buffer.size(), stream) == buffer.size();
+			data = buffer.data();
+			size = buffer.size();
+			fclose(stream);
+			stream = NULL;
+		}
+	}
+
+	BinaryReader::BinaryReader(const uint8_t* data, size_t size, size_t origin, size_t position,
+	                           size_t fileSize)
+	    : stream{ NULL }, data{ data }, size{ size }, origin{ origin }, position{ position },
+	      fileSize{ fileSize }, valid{ true }
+	{
+	}
+
+	BinaryReader::BinaryReader(const uint8_t* data, size_t size)
+	    : BinaryReader(data, size, 0, 0, size)
+	{
 	}
 
 	BinaryReader::~BinaryReader()
@@ -17,7 +56,7 @@ namespace IO
 
 	bool BinaryReader::isStreamValid()
 	{
-		return stream;
+		return valid;
 	}
 
 	void BinaryReader::close()
@@ -26,71 +65,128 @@ namespace IO
 			fclose(stream);
 
 		stream = NULL;
+		buffer.clear();
+		buffer.shrink_to_fit();
+		data = nullptr;
+		size = origin = position = 0;
+		valid = false;
 	}
 
-	size_t BinaryReader::getFileSize()
+	void BinaryReader::load(size_t offset, size_t length)
 	{
-		size_t pos = ftell(stream);
-		fseek(stream, 0, SEEK_END);
+		if (!stream || offset > fileSize)
+			throw std::runtime_error("Unexpected end of file.");
+
+		length = std::min(length, fileSize - offset);
+		buffer.resize(length);
+		fseek(stream, offset, SEEK_SET);
+		if (fread(buffer.data(), 1, length, stream) != length)
+			throw std::runtime_error("Failed to read file.");
+
+		data = buffer.data();
+		size = buffer.size();
+		origin = offset;
+		position = 0;
+	}
 
-		size_t size = ftell(stream);
-		fseek(stream, pos, SEEK_SET);
+	BinaryReader BinaryReader::readerAt(size_t pos) const
+	{
+		if (pos < origin || pos - origin > size)
+			throw std::runtime_error("Unexpected end of file.");
 
-		return size;
+		return BinaryReader(data, size, origin, pos - origin, fileSize);
+	}
+
+	size_t BinaryReader::getFileSize()
+	{
+		return fileSize;
 	}
 
 	size_t BinaryReader::getStreamPosition()
 	{
-		return ftell(stream);
+		return origin + position;
 	}
 
-	uint16_t BinaryReader::readInt16()
+	const uint8_t* BinaryReader::advance(size_t length)
 	{
-    uint16_t data = 0;
-		if (stream)
-			fread(&data, sizeof(uint16_t), 1, stream);
+		if (length > size - position)
+			throw std::runtime_error("Unexpected end of file.");
 
-		return data;
+		const uint8_t* bytes = data + position;
+		position += length;
+		return bytes;
 	}
 
-	uint32_t BinaryReader::readInt32()
+	uint8_t BinaryReader::readInt8()
 	{
-		uint32_t data = 0;
-		if (stream)
-			fread(&data, sizeof(uint32_t), 1, stream);
+		return *advance(sizeof(uint8_t));
+	}
 
-		return data;
+	uint16_t BinaryReader::readInt16()
+	{
+		uint16_t value;
+		memcpy(&value, advance(sizeof(uint16_t)), sizeof(uint16_t));
+		return value;
+	}
+
+	uint32_t BinaryReader::readInt32()
+	{
+		uint32_t value;
+		memcpy(&value, advance(sizeof(uint32_t)), sizeof(uint32_t));
+		return value;
 	}
 
 	float BinaryReader::readSingle()
 	{
-		float data = 0;
-		if (stream)
-			fread(&data, sizeof(float), 1, stream);
+		float value;
+		memcpy(&value, advance(sizeof(float)), sizeof(float));
+		return value;
+	}
+
+	uint32_t BinaryReader::readVarInt()
+	{
+		uint32_t value = 0;
+		for (int shift = 0; shift < 35; shift += 7)
+		{
+			uint8_t byte = *advance(sizeof(uint8_t));
+			value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+				return value;
+		}
 
-		return data;
+		throw std::runtime_error("Invalid variable length integer.");
 	}
 
 	std::string BinaryReader::readString()
 	{
-		char c = 'a';
-		std::string data = "";
-		if (stream)
-		{
-			while (c && !feof(stream))
-			{
-				fread(&c, sizeof(uint8_t), 1, stream);
-				if (c)
-					data += c;
-			}
+		return std::string(readStringView());
+	}
 
-		}
-		return data;
+	std::string_view BinaryReader::readStringView()
+	{
+		if (position >= size)
+			throw std::runtime_error("Unexpected end of file.");
+
+		const uint8_t* begin = data + position;
+		const void* terminator = memchr(begin, '\0', size - position);
+		if (!terminator)
+			throw std::runtime_error("Unexpected end of file.");
+
+		size_t length = static_cast<const uint8_t*>(terminator) - begin;
+		advance(length + 1);
+		return std::string_view(reinterpret_cast<const char*>(begin), length);
+	}
+
+	const uint8_t* BinaryReader::readBytes(size_t length)
+	{
+		return advance(length);
 	}
 
 	void BinaryReader::seek(size_t pos)
 	{
-		if (stream)
-			fseek(stream, pos, SEEK_SET);
+		if (pos < origin || pos - origin > size)
+			throw std::runtime_error("Unexpected end of file.");
+
+		position = pos - origin;
 	}
 }
@@ -1,28 +1,67 @@
 #pragma once
 #include <stdio.h>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace IO
 {
+	// Reads a file into memory and decodes values from the buffer.
+	// Reading past the loaded data throws instead of returning zeros
 	class BinaryReader
 	{
 	private:
 		FILE* stream;
+		std::vector<uint8_t> buffer;
+		const uint8_t* data;
+		size_t size;
+		size_t origin;
+		size_t position;
+		size_t fileSize;
+		bool valid;
+
+		const uint8_t* advance(size_t length);
+		BinaryReader(const uint8_t* data, size_t size, size_t origin, size_t position,
+		             size_t fileSize);
 
 	public:
-		BinaryReader(const std::string& filename);
+		// Reads the whole file unless partial is set, in which case the file is kept open and
+		// only the ranges passed to load can be read
+		BinaryReader(const std::string& filename, bool partial = false);
+
+		// Reads from data owned by the caller, which must outlive the reader
+		BinaryReader(const uint8_t* data, size_t size);
+		BinaryReader(const BinaryReader&) = delete;
 		~BinaryReader();
 
 		bool isStreamValid();
 		void close();
 
+		// Replaces the buffer with up to length bytes starting at offset.
+		// Positions stay relative to the start of the file
+		void load(size_t offset, size_t length);
+
+		// A reader over the data already loaded, starting at pos. Each reader keeps its own
+		// position so sections can be decoded on separate threads while this reader is alive
+		BinaryReader readerAt(size_t pos) const;
+
 		size_t getFileSize();
 		size_t getStreamPosition();
 		void seek(size_t pos);
 
+		uint8_t readInt8();
 		uint16_t readInt16();
 		uint32_t readInt32();
 		float readSingle();
+
+		// Reads an unsigned LEB128 value of up to 32 bits
+		uint32_t readVarInt();
 		std::string readString();
+
+		// The view points into the reader's buffer and is valid until the next load or close
+		std::string_view readStringView();
+
+		// Returns a pointer into the reader's buffer, valid until the next load or close
+		const uint8_t* readBytes(size_t length);
 	};
 }
@@ -1,98 +1,109 @@
 #include "BinaryWriter.h"
 #include "IO.h"
+#include <Windows.h>
+#include <cstring>
+#include <io.h>
+#include <stdexcept>
 
 namespace IO
 {
-	BinaryWriter::BinaryWriter(const std::string& filename)
+	BinaryWriter::BinaryWriter(const std::string& filename) : filename{ filename }
 	{
-		stream = NULL;
-		std::wstring wFilename = mbToWideStr(filename);
-		stream = _wfopen(wFilename.c_str(), L"wb");
 	}
 
-	BinaryWriter::~BinaryWriter()
+	BinaryWriter::BinaryWriter() {}
+
+	void BinaryWriter::flush()
 	{
-		close();
+		std::wstring wFilename = mbToWideStr(filename);
+		std::wstring wTempFilename = wFilename + L".tmp";
+
+		FILE* stream = _wfopen(wTempFilename.c_str(), L"wb");
+		if (!stream)
+			throw std::runtime_error("Failed to create " + filename);
+
+		// Make sure the data reached the disk before the temporary file replaces the target
+		bool written = fwrite(buffer.data(), 1, buffer.size(), stream) == buffer.size();
+		written = fflush(stream) == 0 && written;
+		written = _commit(_fileno(stream)) == 0 && written;
+		written = fclose(stream) == 0 && written;
+
+		if (!written || !MoveFileExW(wTempFilename.c_str(), wFilename.c_str(),
+		                             MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		{
+			_wremove(wTempFilename.c_str());
+			throw std::runtime_error("Failed to write " + filename);
+		}
 	}
 
-	bool BinaryWriter::isStreamValid()
+	void BinaryWriter::reserve(size_t size)
 	{
-		return stream;
+		buffer.reserve(size);
 	}
 
-	void BinaryWriter::close()
+	size_t BinaryWriter::getStreamPosition()
 	{
-		if (stream)
-			fclose(stream);
+		return buffer.size();
 	}
 
-	void BinaryWriter::flush()
+	const std::vector<uint8_t>& BinaryWriter::getBuffer() const
 	{
-		if (stream)
-			fflush(stream);
+		return buffer;
 	}
 
-	size_t BinaryWriter::getFileSize()
+	void BinaryWriter::writeInt8(uint8_t data)
 	{
-		size_t pos = ftell(stream);
-		fseek(stream, 0, SEEK_END);
-
-		size_t size = ftell(stream);
-		fseek(stream, pos, SEEK_SET);
+		buffer.push_back(data);
+	}
 
-		return size;
+	void BinaryWriter::writeInt16(uint16_t data)
+	{
+		writeBytes(&data, sizeof(uint16_t));
 	}
 
-	size_t BinaryWriter::getStreamPosition()
+	void BinaryWriter::writeInt32(uint32_t data)
 	{
-		return ftell(stream);
+		writeBytes(&data, sizeof(uint32_t));
 	}
 
-	void BinaryWriter::seek(size_t pos)
+	void BinaryWriter::writeSingle(float data)
 	{
-		if (stream)
-			fseek(stream, pos, SEEK_SET);
+		writeBytes(&data, sizeof(float));
 	}
 
-	void BinaryWriter::writeInt16(uint16_t data)
+	void BinaryWriter::writeVarInt(uint32_t data)
 	{
-		if (stream)
-			fwrite(&data, sizeof(uint16_t), 1, stream);
+		while (data >= 0x80)
+		{
+			buffer.push_back(static_cast<uint8_t>(data) | 0x80);
+			data >>= 7;
+		}
+
+		buffer.push_back(static_cast<uint8_t>(data));
 	}
 
-	void BinaryWriter::writeInt32(uint32_t data)
+	void BinaryWriter::writeNull(size_t length)
 	{
-		if (stream)
-			fwrite(&data, sizeof(uint32_t), 1, stream);
+		buffer.resize(buffer.size() + length, 0);
 	}
 
-	void BinaryWriter::writeSingle(float data)
+	void BinaryWriter::writeBytes(const void* data, size_t length)
 	{
-		if (stream)
-			fwrite(&data, sizeof(float), 1, stream);
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		buffer.insert(buffer.end(), bytes, bytes + length);
 	}
 
-	void BinaryWriter::writeNull(size_t length)
+	void BinaryWriter::writeString(const std::string& data)
 	{
-		uint8_t zero = 0;
-		if (stream)
-			fwrite(&zero, sizeof(uint8_t), length, stream);
+		// Includes the null terminator
+		writeBytes(data.c_str(), data.size() + 1);
 	}
 
-	void BinaryWriter::writeString(std::string data)
+	void BinaryWriter::patchInt32(size_t pos, uint32_t data)
 	{
-		if (stream)
-		{
-			size_t length = data.size();
-			if (length)
-			{
-				fwrite(data.c_str(), sizeof(char), length, stream);
-				writeNull(1);
-			}
-			else
-			{
-				writeNull(1);
-			}
-		}
+		if (pos + sizeof(uint32_t) > buffer.size())
+			throw std::out_of_range("Patch position is past the end of the buffer");
+
+		memcpy(buffer.data() + pos, &data, sizeof(uint32_t));
 	}
 }
@@ -1,30 +1,44 @@
 #pragma once
 #include <stdio.h>
 #include <string>
+#include <vector>
 
 namespace IO
 {
+	// Builds the whole file in memory. flush writes it to a temporary file in one call and
+	// renames it over the target, so a failed save leaves the previous file intact
 	class BinaryWriter
 	{
 	private:
-		FILE* stream;
+		std::string filename;
+		std::vector<uint8_t> buffer;
 
 	public:
 		BinaryWriter(const std::string& filename);
-		~BinaryWriter();
 
-		bool isStreamValid();
-		void close();
+		// Builds data in memory only. Use getBuffer instead of flush
+		BinaryWriter();
+
+		// Throws if the file could not be written
 		void flush();
 
-		size_t getFileSize();
+		void reserve(size_t size);
 		size_t getStreamPosition();
+		const std::vector<uint8_t>& getBuffer() const;
 
-		void seek(size_t pos);
+		void writeInt8(uint8_t data);
 		void writeInt16(uint16_t data);
 		void writeInt32(uint32_t data);
 		void writeSingle(float data);
-		void writeString(std::string data);
+
+		// Writes an unsigned LEB128 value, one byte for every 7 bits used
+		void writeVarInt(uint32_t data);
+
+		void writeString(const std::string& data);
 		void writeNull(size_t length);
+		void writeBytes(const void* data, size_t length);
+
+		// Overwrites a value written earlier, such as a count or an offset only known later
+		void patchInt32(size_t pos, uint32_t data);
 	};
 }
@@ -55,6 +55,8 @@ namespace MikuMikuWorld
 		{"auto_save_enable", "Auto Save Enabled"},
 		{"auto_save_interval", "Auto Save Interval (min)"},
 		{"auto_save_count", "Maximum Auto Save Entries"},
+		{"history", "History"},
+		{"history_memory_limit", "Undo History Memory Limit (MB)"},
 		{"theme", "Theme"},
 		{"base_theme", "Base Theme"},
 		{"theme_light", "Light"},
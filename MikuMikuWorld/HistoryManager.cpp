@@ -1,46 +1,313 @@
 #include "HistoryManager.h"
+#include <algorithm>
 
 namespace MikuMikuWorld
 {
-	Score HistoryManager::undo()
+	static bool isEqual(const Note& a, const Note& b)
 	{
-		History history = undoHistory.top();
-		redoHistory.push(history);
-		undoHistory.pop();
+		return a.getType() == b.getType() && a.ID == b.ID && a.parentID == b.parentID &&
+		       a.tick == b.tick && a.lane == b.lane && a.width == b.width &&
+		       a.critical == b.critical && a.friction == b.friction && a.flick == b.flick &&
+		       a.layer == b.layer;
+	}
+
+	static bool isEqual(const HoldStep& a, const HoldStep& b)
+	{
+		return a.ID == b.ID && a.type == b.type && a.ease == b.ease;
+	}
+
+	static bool isEqual(const HoldNote& a, const HoldNote& b)
+	{
+		return isEqual(a.start, b.start) && a.end == b.end && a.startType == b.startType &&
+		       a.endType == b.endType && a.fadeType == b.fadeType &&
+		       a.guideColor == b.guideColor && a.steps.size() == b.steps.size() &&
+		       std::equal(a.steps.begin(), a.steps.end(), b.steps.begin(),
+		                  [](const HoldStep& x, const HoldStep& y) { return isEqual(x, y); });
+	}
+
+	static bool isEqual(const HiSpeedChange& a, const HiSpeedChange& b)
+	{
+		return a.ID == b.ID && a.tick == b.tick && a.speed == b.speed && a.layer == b.layer;
+	}
+
+	static bool isEqual(const Tempo& a, const Tempo& b)
+	{
+		return a.tick == b.tick && a.bpm == b.bpm;
+	}
+
+	static bool isEqual(const TimeSignature& a, const TimeSignature& b)
+	{
+		return a.measure == b.measure && a.numerator == b.numerator &&
+		       a.denominator == b.denominator;
+	}
+
+	static bool isEqual(const SkillTrigger& a, const SkillTrigger& b)
+	{
+		return a.ID == b.ID && a.tick == b.tick;
+	}
+
+	static bool isEqual(const Fever& a, const Fever& b)
+	{
+		return a.startTick == b.startTick && a.endTick == b.endTick;
+	}
 
-		return history.prev;
+	static bool isEqual(const Layer& a, const Layer& b) { return a.name == b.name; }
+
+	static bool isEqual(const Waypoint& a, const Waypoint& b)
+	{
+		return a.name == b.name && a.tick == b.tick;
+	}
+
+	template <typename K, typename T>
+	static bool isEqual(const std::pair<const K, T>& a, const std::pair<const K, T>& b)
+	{
+		return a.first == b.first && isEqual(a.second, b.second);
+	}
+
+	template <typename List>
+	static bool isEqualList(const List& a, const List& b)
+	{
+		return a.size() == b.size() &&
+		       std::equal(a.begin(), a.end(), b.begin(),
+		                  [](const auto& x, const auto& y) { return isEqual(x, y); });
+	}
+
+	template <typename T, typename Map>
+	static void diffElements(const Map& prev, const Map& curr,
+	                         std::vector<ElementChange<T>>& changes)
+	{
+		size_t added = 0;
+		for (const auto& [id, value] : curr)
+		{
+			auto it = prev.find(id);
+			if (it == prev.end())
+			{
+				changes.push_back({ id, std::nullopt, value });
+				added++;
+			}
+			else if (!isEqual(it->second, value))
+			{
+				changes.push_back({ id, it->second, value });
+			}
+		}
+
+		// Nothing was removed if every element of prev is still in curr
+		if (prev.size() + added != curr.size())
+		{
+			for (const auto& [id, value] : prev)
+				if (curr.find(id) == curr.end())
+					changes.push_back({ id, value, std::nullopt });
+		}
+
+		changes.shrink_to_fit();
 	}
 
-	Score HistoryManager::redo()
+	template <typename List>
+	static void diffList(const List& prev, const List& curr,
+	                     std::optional<ListChange<List>>& change)
 	{
-		History history = redoHistory.top();
-		undoHistory.push(history);
-		redoHistory.pop();
+		if (!isEqualList(prev, curr))
+			change = ListChange<List>{ prev, curr };
+	}
 
-		return history.curr;
+	template <typename T, typename Map>
+	static void applyElements(Map& map, const std::vector<ElementChange<T>>& changes, bool forward)
+	{
+		for (const auto& change : changes)
+		{
+			const std::optional<T>& value = forward ? change.curr : change.prev;
+			if (value)
+				map[change.ID] = *value;
+			else
+				map.erase(change.ID);
+		}
 	}
 
-	void HistoryManager::pushHistory(const std::string& description, const Score& prev, const Score& curr)
+	template <typename List>
+	static void applyList(List& list, const std::optional<ListChange<List>>& change, bool forward)
 	{
-		History history{ description, prev, curr };
-		pushHistory(history);
+		if (change)
+			list = forward ? change->curr : change->prev;
 	}
 
-	void HistoryManager::pushHistory(const History& history)
+	static void invalidateHoldGeometry(const History& history, Score& score)
 	{
-		undoHistory.push(history);
-		
-		while (!redoHistory.empty())
-			redoHistory.pop();
+		for (const auto& change : history.holdNotes)
+			score.invalidateHoldGeometry(change.ID);
+
+		// A note may have moved between holds, so the holds on both sides are invalidated
+		for (const auto& change : history.notes)
+		{
+			if (change.prev)
+				score.invalidateHoldGeometry(*change.prev);
+
+			if (change.curr)
+				score.invalidateHoldGeometry(*change.curr);
+		}
 	}
 
-	void HistoryManager::clear()
+	static void applyHistory(const History& history, Score& score, bool forward)
 	{
-		while (!undoHistory.empty())
-			undoHistory.pop();
+		applyElements(score.notes, history.notes, forward);
+		applyElements(score.holdNotes, history.holdNotes, forward);
+		applyElements(score.hiSpeedChanges, history.hiSpeedChanges, forward);
+		applyList(score.tempoChanges, history.tempoChanges, forward);
+		applyList(score.timeSignatures, history.timeSignatures, forward);
+		applyList(score.skills, history.skills, forward);
+		applyList(score.layers, history.layers, forward);
+		applyList(score.waypoints, history.waypoints, forward);
+		if (history.fever)
+			score.fever = forward ? history.fever->curr : history.fever->prev;
+
+		if (history.notes.size() || history.holdNotes.size())
+		{
+			score.invalidateTickIndex();
+			invalidateHoldGeometry(history, score);
+		}
+
+		if (history.hiSpeedChanges.size() || history.layers)
+			score.invalidateHiSpeedIndex();
+
+		if (history.tempoChanges)
+			score.invalidateTempoMap();
+
+		if (history.timeSignatures)
+			score.invalidateMeasureTable();
+	}
 
-		while (!redoHistory.empty())
-			redoHistory.pop();
+	static size_t estimateSize(const HoldNote& hold)
+	{
+		return hold.steps.capacity() * sizeof(HoldStep);
+	}
+
+	static size_t estimateSize(const std::vector<Layer>& layers)
+	{
+		size_t size = layers.capacity() * sizeof(Layer);
+		for (const Layer& layer : layers)
+			size += layer.name.capacity();
+
+		return size;
+	}
+
+	static size_t estimateSize(const std::vector<Waypoint>& waypoints)
+	{
+		size_t size = waypoints.capacity() * sizeof(Waypoint);
+		for (const Waypoint& waypoint : waypoints)
+			size += waypoint.name.capacity();
+
+		return size;
+	}
+
+	static size_t estimateSize(const History& history)
+	{
+		// Map nodes carry about four pointers of overhead each
+		constexpr size_t nodeOverhead = sizeof(void*) * 4;
+
+		size_t size = sizeof(History) + history.description.capacity();
+		size += history.notes.capacity() * sizeof(ElementChange<Note>);
+		size += history.hiSpeedChanges.capacity() * sizeof(ElementChange<HiSpeedChange>);
+		size += history.holdNotes.capacity() * sizeof(ElementChange<HoldNote>);
+		for (const auto& change : history.holdNotes)
+		{
+			if (change.prev)
+				size += estimateSize(*change.prev);
+
+			if (change.curr)
+				size += estimateSize(*change.curr);
+		}
+
+		if (history.tempoChanges)
+			size += (history.tempoChanges->prev.capacity() +
+			         history.tempoChanges->curr.capacity()) *
+			        sizeof(Tempo);
+
+		if (history.timeSignatures)
+			size += (history.timeSignatures->prev.size() +
+			         history.timeSignatures->curr.size()) *
+			        (sizeof(std::pair<const int, TimeSignature>) + nodeOverhead);
+
+		if (history.skills)
+			size += (history.skills->prev.capacity() + history.skills->curr.capacity()) *
+			        sizeof(SkillTrigger);
+
+		if (history.layers)
+			size += estimateSize(history.layers->prev) + estimateSize(history.layers->curr);
+
+		if (history.waypoints)
+			size += estimateSize(history.waypoints->prev) + estimateSize(history.waypoints->curr);
+
+		return size;
+	}
+
+	void HistoryManager::undo(Score& score)
+	{
+		History& history = undoHistory.back();
+		applyHistory(history, base, false);
+		applyHistory(history, score, false);
+
+		redoHistory.push_back(std::move(history));
+		undoHistory.pop_back();
+	}
+
+	void HistoryManager::redo(Score& score)
+	{
+		History& history = redoHistory.back();
+		applyHistory(history, base, true);
+		applyHistory(history, score, true);
+
+		undoHistory.push_back(std::move(history));
+		redoHistory.pop_back();
+	}
+
+	void HistoryManager::pushHistory(const std::string& description, Score& score)
+	{
+		History history{ description };
+		diffElements(base.notes, score.notes, history.notes);
+		diffElements(base.holdNotes, score.holdNotes, history.holdNotes);
+		diffElements(base.hiSpeedChanges, score.hiSpeedChanges, history.hiSpeedChanges);
+		diffList(base.tempoChanges, score.tempoChanges, history.tempoChanges);
+		diffList(base.timeSignatures, score.timeSignatures, history.timeSignatures);
+		diffList(base.skills, score.skills, history.skills);
+		diffList(base.layers, score.layers, history.layers);
+		diffList(base.waypoints, score.waypoints, history.waypoints);
+		if (!isEqual(base.fever, score.fever))
+			history.fever = ListChange<Fever>{ base.fever, score.fever };
+
+		applyHistory(history, base, true);
+		invalidateHoldGeometry(history, score);
+		history.memorySize = estimateSize(history);
+
+		for (const History& redo : redoHistory)
+			memoryUsage -= redo.memorySize;
+
+		redoHistory.clear();
+		memoryUsage += history.memorySize;
+		undoHistory.push_back(std::move(history));
+		trimToLimit();
+	}
+
+	void HistoryManager::reset(const Score& score)
+	{
+		undoHistory.clear();
+		redoHistory.clear();
+		memoryUsage = 0;
+		base = score;
+	}
+
+	void HistoryManager::setMemoryLimit(size_t bytes)
+	{
+		memoryLimit = bytes;
+		trimToLimit();
+	}
+
+	void HistoryManager::trimToLimit()
+	{
+		// The latest edit is always kept so it can be undone
+		while (memoryUsage > memoryLimit && undoHistory.size() > 1)
+		{
+			memoryUsage -= undoHistory.front().memorySize;
+			undoHistory.pop_front();
+		}
 	}
 
 	bool HistoryManager::hasUndo() const
@@ -65,11 +332,11 @@ namespace MikuMikuWorld
 
 	std::string HistoryManager::peekUndo() const
 	{
-		return undoHistory.size() ? undoHistory.top().description : "";
+		return undoHistory.size() ? undoHistory.back().description : "";
 	}
 
 	std::string HistoryManager::peekRedo() const
 	{
-		return redoHistory.size() ? redoHistory.top().description : "";
+		return redoHistory.size() ? redoHistory.back().description : "";
 	}
-}
\ No newline at end of file
+}
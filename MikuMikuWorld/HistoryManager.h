@@ -1,38 +1,83 @@
 #pragma once
-#include <stack>
+#include <deque>
+#include <limits>
 #include <map>
-#include <unordered_map>
+#include <optional>
 #include <string>
+#include <vector>
 #include "Score.h"
 
 namespace MikuMikuWorld
 {
+	// An element before and after an edit. An empty value means it did not exist on that side
+	template <typename T>
+	struct ElementChange
+	{
+		int ID;
+		std::optional<T> prev;
+		std::optional<T> curr;
+	};
+
+	template <typename T>
+	struct ListChange
+	{
+		T prev;
+		T curr;
+	};
+
+	// The parts of a score changed by an edit. It can be applied in either direction
 	struct History
 	{
 		std::string description;
-		Score prev;
-		Score curr;
+
+		std::vector<ElementChange<Note>> notes;
+		std::vector<ElementChange<HoldNote>> holdNotes;
+		std::vector<ElementChange<HiSpeedChange>> hiSpeedChanges;
+
+		// Event lists are short so they are recorded whole when changed
+		std::optional<ListChange<std::vector<Tempo>>> tempoChanges;
+		std::optional<ListChange<std::map<int, TimeSignature>>> timeSignatures;
+		std::optional<ListChange<std::vector<SkillTrigger>>> skills;
+		std::optional<ListChange<Fever>> fever;
+		std::optional<ListChange<std::vector<Layer>>> layers;
+		std::optional<ListChange<std::vector<Waypoint>>> waypoints;
+
+		size_t memorySize{};
 	};
 
 	class HistoryManager
 	{
 	private:
-		std::stack<History> undoHistory;
-		std::stack<History> redoHistory;
+		std::deque<History> undoHistory;
+		std::deque<History> redoHistory;
+
+		// The score as of the last recorded edit. New edits are found by comparing against it
+		Score base;
+		size_t memoryUsage{};
+		size_t memoryLimit{ std::numeric_limits<size_t>::max() };
+
+		void trimToLimit();
 
 	public:
-		Score undo();
-		Score redo();
+		void undo(Score& score);
+		void redo(Score& score);
 
 		int undoCount() const;
 		int redoCount() const;
 		std::string peekUndo() const;
 		std::string peekRedo() const;
 
-		void pushHistory(const History& history);
-		void pushHistory(const std::string& description, const Score& prev, const Score& curr);
-		void clear();
+		// Records the changes made to score since the last recorded edit and invalidates the
+		// geometry of the holds they changed
+		void pushHistory(const std::string& description, Score& score);
+
+		// Clears the history and starts recording changes from score
+		void reset(const Score& score);
 		bool hasUndo() const;
 		bool hasRedo() const;
+
+		// The oldest edits are dropped once the history uses more than the limit
+		void setMemoryLimit(size_t bytes);
+		inline size_t getMemoryUsage() const { return memoryUsage; }
 	};
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 #include "IO.h"
 #include <Windows.h>
 #include <algorithm>
+#include <array>
 
 namespace IO
 {
@@ -87,12 +88,12 @@ namespace IO
 
 	bool startsWith(const std::string_view& line, const std::string_view& key)
 	{
-		return std::equal(key.begin(), key.end(), line.begin());
+		return line.size() >= key.size() && std::equal(key.begin(), key.end(), line.begin());
 	}
 
 	bool endsWith(const std::string_view& line, const std::string_view& key)
 	{
-		return std::equal(key.rbegin(), key.rend(), line.rbegin());
+		return line.size() >= key.size() && std::equal(key.rbegin(), key.rend(), line.rbegin());
 	}
 
 	bool isDigit(const std::string_view& str)
@@ -153,4 +154,71 @@ namespace IO
 	{
 		return std::string(s1).append(join).append(s2);
 	}
+
+	constexpr const char base64Digits[] =
+	    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	std::string base64Encode(const std::vector<uint8_t>& data)
+	{
+		std::string text;
+		text.reserve((data.size() + 2) / 3 * 4);
+
+		size_t i = 0;
+		for (; i + 2 < data.size(); i += 3)
+		{
+			uint32_t group = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+			text += base64Digits[(group >> 18) & 0x3f];
+			text += base64Digits[(group >> 12) & 0x3f];
+			text += base64Digits[(group >> 6) & 0x3f];
+			text += base64Digits[group & 0x3f];
+		}
+
+		if (i < data.size())
+		{
+			uint32_t group = data[i] << 16;
+			if (i + 1 < data.size())
+				group |= data[i + 1] << 8;
+
+			text += base64Digits[(group >> 18) & 0x3f];
+			text += base64Digits[(group >> 12) & 0x3f];
+			text += i + 1 < data.size() ? base64Digits[(group >> 6) & 0x3f] : '=';
+			text += '=';
+		}
+
+		return text;
+	}
+
+	std::vector<uint8_t> base64Decode(const std::string_view& text)
+	{
+		std::array<int8_t, 256> values;
+		values.fill(-1);
+		for (int i = 0; i < 64; ++i)
+			values[static_cast<uint8_t>(base64Digits[i])] = i;
+
+		std::vector<uint8_t> data;
+		data.reserve(text.size() / 4 * 3);
+
+		uint32_t group = 0;
+		int bits = 0;
+		for (char c : text)
+		{
+			// Line breaks may be added by whatever put the text on the clipboard
+			if (c == '=' || c == '\r' || c == '\n')
+				continue;
+
+			int8_t value = values[static_cast<uint8_t>(c)];
+			if (value == -1)
+				throw std::runtime_error("Invalid base64 data.");
+
+			group = (group << 6) | value;
+			bits += 6;
+			if (bits >= 8)
+			{
+				bits -= 8;
+				data.push_back(static_cast<uint8_t>(group >> bits));
+			}
+		}
+
+		return data;
+	}
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <stdexcept>
 #include <memory>
@@ -51,6 +52,10 @@ namespace IO
 
 	std::string concat(const char* s1, const char* s2, const char* join = "");
 
+	// Standard base64 with padding. Decoding throws on characters outside the alphabet
+	std::string base64Encode(const std::vector<uint8_t>& data);
+	std::vector<uint8_t> base64Decode(const std::string_view& text);
+
 	template<typename ... Args>
 	std::string formatString(const char* format, Args ... args)
 	{
@@ -5,10 +5,6 @@
 
 namespace MikuMikuWorld
 {
-	int nextID = 1;
-	int nextSkillID = 1;
-	int nextHiSpeedID = 1;
-
 	Note::Note(NoteType _type)
 	    : type{ _type }, parentID{ -1 }, tick{ 0 }, lane{ 0 }, width{ 3 }, critical{ false },
 	      friction{ false }
@@ -36,8 +32,6 @@ namespace MikuMikuWorld
 
 	bool Note::canFlick() const { return type == NoteType::Tap || type == NoteType::HoldEnd; }
 
-	void resetNextID() { nextID = 1; }
-
 	void cycleFlick(Note& note)
 	{
 		if (note.getType() == NoteType::Hold || note.getType() == NoteType::HoldMid)
@@ -1,5 +1,6 @@
 #pragma once
 #include "NoteTypes.h"
+#include "SlotMap.h"
 #include <string>
 #include <vector>
 
@@ -51,7 +52,6 @@ namespace MikuMikuWorld
 	};
 
 	extern NoteTextures noteTextures;
-	extern int nextID;
 
 	class Note
 	{
@@ -109,8 +109,6 @@ namespace MikuMikuWorld
 
 	struct Score;
 
-	void resetNextID();
-
 	void cycleFlick(Note& note);
 	void cycleStepEase(HoldStep& note);
 	void cycleStepType(HoldStep& note);
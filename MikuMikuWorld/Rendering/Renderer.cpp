@@ -138,6 +138,11 @@ namespace MikuMikuWorld
 			q.vertices[i].uv = uvCoords[i];
 		}
 
+		pushQuad(q);
+	}
+
+	void Renderer::pushQuad(const Quad& q)
+	{
 		quads.push_back(q);
 
 		++numQuads;
@@ -145,6 +150,17 @@ namespace MikuMikuWorld
 		numIndices += 6;
 	}
 
+	std::vector<Quad> Renderer::takeQuads(size_t first)
+	{
+		std::vector<Quad> taken(quads.begin() + first, quads.end());
+		quads.erase(quads.begin() + first, quads.end());
+
+		numQuads -= taken.size();
+		numVertices -= taken.size() * 4;
+		numIndices -= taken.size() * 6;
+		return taken;
+	}
+
 	void Renderer::resetRenderStats()
 	{
 		numIndices = 0;
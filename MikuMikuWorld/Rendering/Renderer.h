@@ -50,6 +50,11 @@ namespace MikuMikuWorld
 
 		void pushQuad(const std::array<DirectX::XMVECTOR, 4>& pos, const std::array<DirectX::XMVECTOR, 4>& uv,
 			const DirectX::XMMATRIX& m, const DirectX::XMVECTOR& col, int tex, int z);
+		void pushQuad(const Quad& q);
+
+		// Removes the quads pushed from index first on and returns them so they can be pushed again
+		std::vector<Quad> takeQuads(size_t first);
+		inline size_t getQueuedQuadCount() const { return quads.size(); }
 
 		void bindTexture(int tex);
 		void beginBatch();
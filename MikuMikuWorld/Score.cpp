@@ -4,6 +4,10 @@
 #include "Constants.h"
 #include "File.h"
 #include "IO.h"
+#include <algorithm>
+#include <climits>
+#include <future>
+#include <tuple>
 #include <unordered_set>
 
 using namespace IO;
@@ -23,6 +27,9 @@ namespace MikuMikuWorld
 		HOLD_GUIDE = 1 << 2
 	};
 
+	// Smaller files are decoded on the calling thread
+	constexpr size_t parallelDecodeSize = 256 * 1024;
+
 	Score::Score()
 	{
 		metadata.title = "";
@@ -32,12 +39,156 @@ namespace MikuMikuWorld
 
 		tempoChanges.push_back(Tempo());
 		timeSignatures[0] = { 0, 4, 4 };
-		auto id = nextHiSpeedID++;
+		auto id = allocateHiSpeedID();
 		hiSpeedChanges[id] = HiSpeedChange{ id, 0, 1.0f, 0 };
 
 		fever.startTick = fever.endTick = -1;
 	}
 
+	int Score::allocateNoteIDs(int count)
+	{
+		int first = nextNoteID;
+		nextNoteID += count;
+		return first;
+	}
+
+	int Score::allocateHiSpeedIDs(int count)
+	{
+		int first = nextHiSpeedID;
+		nextHiSpeedID += count;
+		return first;
+	}
+
+	const TempoMap& Score::getTempoMap() const
+	{
+		if (!caches.tempoMap.isValid(tempoChanges))
+			caches.tempoMap.rebuild(tempoChanges, TICKS_PER_BEAT);
+
+		return caches.tempoMap;
+	}
+
+	void Score::invalidateTempoMap() { caches.tempoMap.invalidate(); }
+
+	const MeasureTable& Score::getMeasureTable() const
+	{
+		if (!caches.measureTable.isValid(timeSignatures))
+			caches.measureTable.rebuild(timeSignatures, TICKS_PER_BEAT);
+
+		return caches.measureTable;
+	}
+
+	void Score::invalidateMeasureTable() { caches.measureTable.invalidate(); }
+
+	int Score::findHiSpeedChange(int tick, int layer) const
+	{
+		if (!caches.hiSpeedIndex.isValid(hiSpeedChanges))
+			caches.hiSpeedIndex.rebuild(hiSpeedChanges);
+
+		return caches.hiSpeedIndex.findActive(tick, layer);
+	}
+
+	std::vector<int> Score::hiSpeedChangesInTickRange(int begin, int end, int layer) const
+	{
+		if (!caches.hiSpeedIndex.isValid(hiSpeedChanges))
+			caches.hiSpeedIndex.rebuild(hiSpeedChanges);
+
+		std::vector<int> ids;
+		caches.hiSpeedIndex.query(begin, end, layer, ids);
+		return ids;
+	}
+
+	void Score::addHiSpeedChange(const HiSpeedChange& hiSpeed)
+	{
+		auto it = hiSpeedChanges.find(hiSpeed.ID);
+		if (it != hiSpeedChanges.end())
+			caches.hiSpeedIndex.erase(it->second);
+
+		hiSpeedChanges[hiSpeed.ID] = hiSpeed;
+		caches.hiSpeedIndex.insert(hiSpeed);
+	}
+
+	void Score::eraseHiSpeedChange(int id)
+	{
+		auto it = hiSpeedChanges.find(id);
+		if (it == hiSpeedChanges.end())
+			return;
+
+		caches.hiSpeedIndex.erase(it->second);
+		hiSpeedChanges.erase(it);
+	}
+
+	void Score::moveHiSpeedChange(HiSpeedChange& hiSpeed, int tick)
+	{
+		caches.hiSpeedIndex.move(hiSpeed, tick);
+		hiSpeed.tick = tick;
+	}
+
+	void Score::invalidateHiSpeedIndex() { caches.hiSpeedIndex.invalidate(); }
+
+	std::vector<int> Score::notesInTickRange(int begin, int end) const
+	{
+		if (!caches.noteTickIndex.isValid(notes))
+			caches.noteTickIndex.rebuild(notes);
+
+		std::vector<int> ids;
+		caches.noteTickIndex.query(begin, end, ids);
+		return ids;
+	}
+
+	std::vector<int> Score::holdsInTickRange(int begin, int end) const
+	{
+		if (!caches.holdTickIndex.isValid(holdNotes))
+			caches.holdTickIndex.rebuild(notes, holdNotes);
+
+		std::vector<int> ids;
+		caches.holdTickIndex.query(begin, end, ids);
+		return ids;
+	}
+
+	void Score::invalidateTickIndex()
+	{
+		caches.noteTickIndex.invalidate();
+		caches.holdTickIndex.invalidate();
+		caches.noteColumns.invalidate();
+	}
+
+	const std::vector<HoldSegment>& Score::getHoldSegments(int holdID) const
+	{
+		return caches.holdGeometry.get(holdID, notes, holdNotes.at(holdID));
+	}
+
+	void Score::invalidateHoldGeometry(int holdID) { caches.holdGeometry.invalidate(holdID); }
+
+	void Score::invalidateHoldGeometry(const Note& note)
+	{
+		if (note.getType() == NoteType::Hold)
+			caches.holdGeometry.invalidate(note.ID);
+		else if (note.getType() == NoteType::HoldMid || note.getType() == NoteType::HoldEnd)
+			caches.holdGeometry.invalidate(note.parentID);
+	}
+
+	const NoteColumns& Score::getNoteColumns() const
+	{
+		if (!caches.noteColumns.isValid(notes))
+			caches.noteColumns.rebuild(notes);
+
+		return caches.noteColumns;
+	}
+
+	void Score::moveNoteTick(Note& note, int tick)
+	{
+		caches.noteTickIndex.move(note.ID, note.tick, tick);
+		caches.noteColumns.invalidate();
+		note.tick = tick;
+
+		// The range and path of the note's hold may have changed
+		if (note.getType() != NoteType::Tap && note.getType() != NoteType::Damage)
+		{
+			caches.holdTickIndex.invalidate();
+			invalidateHoldGeometry(note);
+		}
+	}
+
 	Note readNote(NoteType type, BinaryReader* reader, int cyanvasVersion)
 	{
 		Note note(type);
@@ -57,24 +208,6 @@ namespace MikuMikuWorld
 		return note;
 	}
 
-	void writeNote(const Note& note, BinaryWriter* writer)
-	{
-		writer->writeInt32(note.tick);
-		writer->writeInt32(note.lane);
-		writer->writeInt32(note.width);
-		writer->writeInt32(note.layer);
-
-		if (!note.hasEase())
-			writer->writeInt32((int)note.flick);
-
-		unsigned int flags{};
-		if (note.critical)
-			flags |= NOTE_CRITICAL;
-		if (note.friction)
-			flags |= NOTE_FRICTION;
-		writer->writeInt32(flags);
-	}
-
 	ScoreMetadata readMetadata(BinaryReader* reader, int version, int cyanvasVersion)
 	{
 		ScoreMetadata metadata;
@@ -135,6 +268,9 @@ namespace MikuMikuWorld
 		if (version > 2)
 		{
 			int hiSpeedCount = reader->readInt32();
+			if (hiSpeedCount)
+				score.hiSpeedChanges.clear();
+
 			for (int i = 0; i < hiSpeedCount; ++i)
 			{
 				int tick = reader->readInt32();
@@ -142,7 +278,7 @@ namespace MikuMikuWorld
 				int layer = 0;
 				if (cyanvasVersion >= 4)
 					layer = reader->readInt32();
-				int id = nextHiSpeedID++;
+				int id = score.allocateHiSpeedID();
 				score.hiSpeedChanges[id] = HiSpeedChange{ id, tick, speed, layer };
 			}
 		}
@@ -154,7 +290,7 @@ namespace MikuMikuWorld
 			for (int i = 0; i < skillCount; ++i)
 			{
 				int tick = reader->readInt32();
-				score.skills.push_back({ nextSkillID++, tick });
+				score.skills.push_back({ score.allocateSkillID(), tick });
 			}
 
 			score.fever.startTick = reader->readInt32();
@@ -162,6 +298,111 @@ namespace MikuMikuWorld
 		}
 	}
 
+	// Saves list elements in a canonical order so identical scores produce identical files
+	// regardless of IDs or the order they were created in
+	static auto canonicalKey(const Note& note)
+	{
+		return std::make_tuple(note.tick, note.lane, note.width, note.getType(), note.layer,
+		                       note.critical, note.friction, note.flick);
+	}
+
+	static bool canonicalLess(const Score& score, const HoldNote& a, const HoldNote& b)
+	{
+		auto key = [&score](const HoldNote& hold)
+		{
+			return std::make_tuple(canonicalKey(score.notes.at(hold.start.ID)),
+			                       canonicalKey(score.notes.at(hold.end)), hold.steps.size(),
+			                       hold.startType, hold.endType, hold.start.ease, hold.fadeType,
+			                       hold.guideColor);
+		};
+
+		auto keyA = key(a);
+		auto keyB = key(b);
+		if (keyA != keyB)
+			return keyA < keyB;
+
+		for (size_t i = 0; i < a.steps.size(); ++i)
+		{
+			const HoldStep& stepA = a.steps[i];
+			const HoldStep& stepB = b.steps[i];
+			auto stepKeyA = std::make_tuple(canonicalKey(score.notes.at(stepA.ID)), stepA.type,
+			                                stepA.ease);
+			auto stepKeyB = std::make_tuple(canonicalKey(score.notes.at(stepB.ID)), stepB.type,
+			                                stepB.ease);
+			if (stepKeyA != stepKeyB)
+				return stepKeyA < stepKeyB;
+		}
+
+		return false;
+	}
+
+	// Sorts the runs of items that the index order leaves tied. Items come from a tick index
+	// so the runs are short and this avoids sorting the whole list
+	template <typename T, typename SameRun, typename Less>
+	static void sortTiedRuns(std::vector<T>& items, SameRun sameRun, Less less)
+	{
+		auto first = items.begin();
+		while (first != items.end())
+		{
+			auto last = std::find_if_not(first + 1, items.end(),
+			                             [&](const T& item) { return sameRun(*first, item); });
+			if (last - first > 1)
+				std::sort(first, last, less);
+
+			first = last;
+		}
+	}
+
+	std::vector<int> canonicalNoteOrder(const Score& score)
+	{
+		std::vector<int> ids;
+		for (int id : score.notesInTickRange(INT_MIN, INT_MAX))
+		{
+			NoteType type = score.notes.at(id).getType();
+			if (type == NoteType::Tap || type == NoteType::Damage)
+				ids.push_back(id);
+		}
+
+		auto sameTick = [&score](int a, int b)
+		{ return score.notes.at(a).tick == score.notes.at(b).tick; };
+		auto noteLess = [&score](int a, int b)
+		{ return canonicalKey(score.notes.at(a)) < canonicalKey(score.notes.at(b)); };
+		sortTiedRuns(ids, sameTick, noteLess);
+
+		return ids;
+	}
+
+	std::vector<int> canonicalHoldOrder(const Score& score)
+	{
+		// Holds come sorted by their earliest tick
+		using HoldEntry = std::pair<int, int>;
+		std::vector<HoldEntry> holds;
+		for (int id : score.holdsInTickRange(INT_MIN, INT_MAX))
+		{
+			const HoldNote& hold = score.holdNotes.at(id);
+			int tick = std::min(score.notes.at(hold.start.ID).tick, score.notes.at(hold.end).tick);
+			for (const HoldStep& step : hold.steps)
+				tick = std::min(tick, score.notes.at(step.ID).tick);
+
+			holds.push_back({ tick, id });
+		}
+
+		sortTiedRuns(
+		    holds, [](const HoldEntry& a, const HoldEntry& b) { return a.first == b.first; },
+		    [&score](const HoldEntry& a, const HoldEntry& b)
+		    {
+			    return canonicalLess(score, score.holdNotes.at(a.second),
+			                         score.holdNotes.at(b.second));
+		    });
+
+		std::vector<int> ids;
+		ids.reserve(holds.size());
+		for (const auto& [_, id] : holds)
+			ids.push_back(id);
+
+		return ids;
+	}
+
 	void writeScoreEvents(const Score& score, BinaryWriter* writer)
 	{
 		writer->writeInt32(score.timeSignatures.size());
@@ -179,12 +420,25 @@ namespace MikuMikuWorld
 			writer->writeSingle(tempo.bpm);
 		}
 
-		writer->writeInt32(score.hiSpeedChanges.size());
+		// There are few hi-speed changes so they are sorted directly
+		std::vector<const HiSpeedChange*> hiSpeeds;
+		hiSpeeds.reserve(score.hiSpeedChanges.size());
 		for (const auto& [_, hiSpeed] : score.hiSpeedChanges)
+			hiSpeeds.push_back(&hiSpeed);
+
+		std::sort(hiSpeeds.begin(), hiSpeeds.end(),
+		          [](const HiSpeedChange* a, const HiSpeedChange* b)
+		          {
+			          return std::tie(a->tick, a->layer, a->speed) <
+			                 std::tie(b->tick, b->layer, b->speed);
+		          });
+
+		writer->writeInt32(hiSpeeds.size());
+		for (const HiSpeedChange* hiSpeed : hiSpeeds)
 		{
-			writer->writeInt32(hiSpeed.tick);
-			writer->writeSingle(hiSpeed.speed);
-			writer->writeInt32(hiSpeed.layer);
+			writer->writeInt32(hiSpeed->tick);
+			writer->writeSingle(hiSpeed->speed);
+			writer->writeInt32(hiSpeed->layer);
 		}
 
 		writer->writeInt32(score.skills.size());
@@ -197,80 +451,57 @@ namespace MikuMikuWorld
 		writer->writeInt32(score.fever.endTick);
 	}
 
-	Score deserializeScore(const std::string& filename)
+	static uint32_t zigzagEncode(int value)
 	{
-		Score score;
-		BinaryReader reader(filename);
-		if (!reader.isStreamValid())
-			return score;
-
-		std::string signature = reader.readString();
-		if (signature != "MMWS" && signature != "CCMMWS")
-			throw std::runtime_error("Not a MMWS file.");
-
-		bool isCyanvas = signature == "CCMMWS";
-
-		int version = reader.readInt16();
-		int cyanvasVersion = reader.readInt16();
-		if (isCyanvas && cyanvasVersion == 0)
-		{
-			cyanvasVersion = 1;
-		}
-
-		uint32_t metadataAddress{};
-		uint32_t eventsAddress{};
-		uint32_t tapsAddress{};
-		uint32_t holdsAddress{};
-		uint32_t damagesAddress{};
-		uint32_t layersAddress{};
-		uint32_t waypointsAddress{};
-		if (version > 2)
-		{
-			metadataAddress = reader.readInt32();
-			eventsAddress = reader.readInt32();
-			tapsAddress = reader.readInt32();
-			holdsAddress = reader.readInt32();
-			if (isCyanvas)
-				damagesAddress = reader.readInt32();
-			if (cyanvasVersion >= 4)
-				layersAddress = reader.readInt32();
-			if (cyanvasVersion >= 5)
-				waypointsAddress = reader.readInt32();
-
-			reader.seek(metadataAddress);
-		}
+		return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+	}
 
-		score.metadata = readMetadata(&reader, version, cyanvasVersion);
+	static int zigzagDecode(uint32_t value)
+	{
+		return static_cast<int>(value >> 1) ^ -static_cast<int>(value & 1);
+	}
 
-		if (version > 2)
-			reader.seek(eventsAddress);
+	// Counts are checked against the remaining data so a corrupt file can't request huge buffers
+	static size_t readCount(BinaryReader* reader)
+	{
+		uint32_t count = reader->readInt32();
+		if (count > reader->getFileSize() - reader->getStreamPosition())
+			throw std::runtime_error("Unexpected end of file.");
 
-		readScoreEvents(score, version, cyanvasVersion, &reader);
+		return count;
+	}
 
-		if (version > 2)
-			reader.seek(tapsAddress);
+	// Notes of one section, decoded without a score so sections can be read in parallel.
+	// Note IDs, parent IDs and hold references are indices into notes until merged
+	struct NoteSection
+	{
+		std::vector<Note> notes;
+		std::vector<HoldNote> holds;
+	};
 
-		int noteCount = reader.readInt32();
-		score.notes.reserve(noteCount);
-		for (int i = 0; i < noteCount; ++i)
-		{
-			Note note = readNote(NoteType::Tap, &reader, cyanvasVersion);
-			note.ID = nextID++;
-			score.notes[note.ID] = note;
-		}
+	NoteSection readNotes(BinaryReader* reader, NoteType type, int cyanvasVersion)
+	{
+		NoteSection section;
+		size_t noteCount = readCount(reader);
+		section.notes.reserve(noteCount);
+		for (size_t i = 0; i < noteCount; ++i)
+			section.notes.push_back(readNote(type, reader, cyanvasVersion));
 
-		if (version > 2)
-			reader.seek(holdsAddress);
+		return section;
+	}
 
-		int holdCount = reader.readInt32();
-		score.holdNotes.reserve(holdCount);
-		for (int i = 0; i < holdCount; ++i)
+	NoteSection readHolds(BinaryReader* reader, int version, int cyanvasVersion)
+	{
+		NoteSection section;
+		size_t holdCount = readCount(reader);
+		section.holds.reserve(holdCount);
+		for (size_t i = 0; i < holdCount; ++i)
 		{
 			HoldNote hold;
 
 			unsigned int flags{};
 			if (version > 3)
-				flags = reader.readInt32();
+				flags = reader->readInt32();
 
 			if (flags & HOLD_START_HIDDEN)
 				hold.startType = HoldNoteType::Hidden;
@@ -281,67 +512,429 @@ namespace MikuMikuWorld
 			if (flags & HOLD_GUIDE)
 				hold.startType = hold.endType = HoldNoteType::Guide;
 
-			Note start = readNote(NoteType::Hold, &reader, cyanvasVersion);
-			start.ID = nextID++;
-			hold.start.ease = (EaseType)reader.readInt32();
-			hold.start.ID = start.ID;
+			Note start = readNote(NoteType::Hold, reader, cyanvasVersion);
+			int startIndex = section.notes.size();
+			hold.start.ease = (EaseType)reader->readInt32();
+			hold.start.ID = startIndex;
 			if (cyanvasVersion >= 2)
 			{
-				hold.fadeType = (FadeType)reader.readInt32();
+				hold.fadeType = (FadeType)reader->readInt32();
 			}
 			if (cyanvasVersion >= 3)
 			{
-				hold.guideColor = (GuideColor)reader.readInt32();
+				hold.guideColor = (GuideColor)reader->readInt32();
 			}
 			else
 			{
 				hold.guideColor = start.critical ? GuideColor::Yellow : GuideColor::Green;
 			}
-			score.notes[start.ID] = start;
+			section.notes.push_back(start);
 
-			int stepCount = reader.readInt32();
+			size_t stepCount = readCount(reader);
 			hold.steps.reserve(stepCount);
-			for (int i = 0; i < stepCount; ++i)
+			for (size_t i = 0; i < stepCount; ++i)
 			{
-				Note mid = readNote(NoteType::HoldMid, &reader, cyanvasVersion);
-				mid.ID = nextID++;
-				mid.parentID = start.ID;
-				score.notes[mid.ID] = mid;
+				Note mid = readNote(NoteType::HoldMid, reader, cyanvasVersion);
+				mid.parentID = startIndex;
 
 				HoldStep step{};
-				step.type = (HoldStepType)reader.readInt32();
-				step.ease = (EaseType)reader.readInt32();
-				step.ID = mid.ID;
+				step.type = (HoldStepType)reader->readInt32();
+				step.ease = (EaseType)reader->readInt32();
+				step.ID = section.notes.size();
 				hold.steps.push_back(step);
+				section.notes.push_back(mid);
 			}
 
-			Note end = readNote(NoteType::HoldEnd, &reader, cyanvasVersion);
-			end.ID = nextID++;
-			end.parentID = start.ID;
-			score.notes[end.ID] = end;
+			Note end = readNote(NoteType::HoldEnd, reader, cyanvasVersion);
+			end.parentID = startIndex;
 
-			hold.end = end.ID;
-			score.holdNotes[start.ID] = hold;
+			hold.end = section.notes.size();
+			section.notes.push_back(end);
+			section.holds.push_back(std::move(hold));
 		}
 
-		if (cyanvasVersion >= 1)
+		return section;
+	}
+
+	// Gives the section's notes consecutive IDs in the order they were read
+	void mergeNoteSection(Score& score, NoteSection& section)
+	{
+		int firstID = score.allocateNoteIDs(section.notes.size());
+		score.notes.reserve(score.notes.size() + section.notes.size());
+		for (size_t i = 0; i < section.notes.size(); ++i)
+		{
+			Note& note = section.notes[i];
+			note.ID = firstID + i;
+			if (note.parentID != -1)
+				note.parentID += firstID;
+
+			score.notes[note.ID] = note;
+		}
+
+		score.holdNotes.reserve(score.holdNotes.size() + section.holds.size());
+		for (HoldNote& hold : section.holds)
+		{
+			hold.start.ID += firstID;
+			for (HoldStep& step : hold.steps)
+				step.ID += firstID;
+
+			hold.end += firstID;
+			score.holdNotes[hold.start.ID] = std::move(hold);
+		}
+	}
+
+	// Cyanvas version 6 stores notes one field at a time. Ticks are delta encoded from the
+	// previous note, the flick type and flags share a byte and the other fields are varints
+	void writeNoteColumns(const std::vector<const Note*>& notes, BinaryWriter* writer)
+	{
+		int previousTick = 0;
+		for (const Note* note : notes)
+		{
+			writer->writeVarInt(zigzagEncode(note->tick - previousTick));
+			previousTick = note->tick;
+		}
+
+		for (const Note* note : notes)
+			writer->writeVarInt(zigzagEncode(note->lane));
+
+		for (const Note* note : notes)
+			writer->writeVarInt(zigzagEncode(note->width));
+
+		for (const Note* note : notes)
+			writer->writeVarInt(zigzagEncode(note->layer));
+
+		for (const Note* note : notes)
+		{
+			uint8_t flags = static_cast<uint8_t>(note->flick) << 2;
+			if (note->critical)
+				flags |= NOTE_CRITICAL;
+			if (note->friction)
+				flags |= NOTE_FRICTION;
+
+			writer->writeInt8(flags);
+		}
+	}
+
+	void readNoteColumns(std::vector<Note>& notes, BinaryReader* reader)
+	{
+		int tick = 0;
+		for (Note& note : notes)
+		{
+			tick += zigzagDecode(reader->readVarInt());
+			note.tick = tick;
+		}
+
+		for (Note& note : notes)
+			note.lane = zigzagDecode(reader->readVarInt());
+
+		for (Note& note : notes)
+			note.width = zigzagDecode(reader->readVarInt());
+
+		for (Note& note : notes)
+			note.layer = zigzagDecode(reader->readVarInt());
+
+		const uint8_t* flags = reader->readBytes(notes.size());
+		for (size_t i = 0; i < notes.size(); ++i)
+		{
+			notes[i].critical = flags[i] & NOTE_CRITICAL;
+			notes[i].friction = flags[i] & NOTE_FRICTION;
+			if (!notes[i].hasEase())
+				notes[i].flick = static_cast<FlickType>((flags[i] >> 2) & 0x3);
+		}
+	}
+
+	NoteSection readNoteColumnSection(BinaryReader* reader, NoteType type)
+	{
+		NoteSection section;
+		section.notes.resize(readCount(reader), Note(type));
+		readNoteColumns(section.notes, reader);
+		return section;
+	}
+
+	// Hold properties are stored as byte columns followed by the notes of every hold,
+	// each written as its start, steps and end
+	void writeHoldColumnSection(const SlotMap<Note>& notes,
+	                            const std::unordered_map<int, HoldNote>& holdNotes,
+	                            const std::vector<int>& holdIDs, BinaryWriter* writer)
+	{
+		writer->writeInt32(holdIDs.size());
+		for (int id : holdIDs)
+		{
+			const HoldNote& hold = holdNotes.at(id);
+			uint8_t flags{};
+			if (hold.startType == HoldNoteType::Guide)
+				flags |= HOLD_GUIDE;
+			if (hold.startType == HoldNoteType::Hidden)
+				flags |= HOLD_START_HIDDEN;
+			if (hold.endType == HoldNoteType::Hidden)
+				flags |= HOLD_END_HIDDEN;
+
+			writer->writeInt8(flags);
+		}
+
+		for (int id : holdIDs)
+			writer->writeInt8(static_cast<uint8_t>(holdNotes.at(id).start.ease));
+
+		for (int id : holdIDs)
+			writer->writeInt8(static_cast<uint8_t>(holdNotes.at(id).fadeType));
+
+		for (int id : holdIDs)
+			writer->writeInt8(static_cast<uint8_t>(holdNotes.at(id).guideColor));
+
+		size_t noteCount = 0;
+		for (int id : holdIDs)
+		{
+			const HoldNote& hold = holdNotes.at(id);
+			writer->writeVarInt(hold.steps.size());
+			noteCount += hold.steps.size() + 2;
+		}
+
+		for (int id : holdIDs)
+			for (const HoldStep& step : holdNotes.at(id).steps)
+				writer->writeInt8(static_cast<uint8_t>(step.type));
+
+		for (int id : holdIDs)
+			for (const HoldStep& step : holdNotes.at(id).steps)
+				writer->writeInt8(static_cast<uint8_t>(step.ease));
+
+		std::vector<const Note*> sectionNotes;
+		sectionNotes.reserve(noteCount);
+		for (int id : holdIDs)
+		{
+			const HoldNote& hold = holdNotes.at(id);
+			sectionNotes.push_back(&notes.at(hold.start.ID));
+			for (const HoldStep& step : hold.steps)
+				sectionNotes.push_back(&notes.at(step.ID));
+
+			sectionNotes.push_back(&notes.at(hold.end));
+		}
+
+		writeNoteColumns(sectionNotes, writer);
+	}
+
+	NoteSection readHoldColumnSection(BinaryReader* reader)
+	{
+		size_t holdCount = readCount(reader);
+		const uint8_t* flags = reader->readBytes(holdCount);
+		const uint8_t* eases = reader->readBytes(holdCount);
+		const uint8_t* fadeTypes = reader->readBytes(holdCount);
+		const uint8_t* guideColors = reader->readBytes(holdCount);
+
+		std::vector<uint32_t> stepCounts(holdCount);
+		size_t totalSteps = 0;
+		for (uint32_t& stepCount : stepCounts)
+		{
+			stepCount = reader->readVarInt();
+			totalSteps += stepCount;
+		}
+
+		const uint8_t* stepTypes = reader->readBytes(totalSteps);
+		const uint8_t* stepEases = reader->readBytes(totalSteps);
+
+		NoteSection section;
+		section.notes.reserve(holdCount * 2 + totalSteps);
+		for (uint32_t stepCount : stepCounts)
+		{
+			section.notes.emplace_back(NoteType::Hold);
+			section.notes.insert(section.notes.end(), stepCount, Note(NoteType::HoldMid));
+			section.notes.emplace_back(NoteType::HoldEnd);
+		}
+
+		readNoteColumns(section.notes, reader);
+
+		section.holds.resize(holdCount);
+		int noteIndex = 0;
+		size_t stepIndex = 0;
+		for (size_t i = 0; i < holdCount; ++i)
 		{
-			reader.seek(damagesAddress);
+			HoldNote& hold = section.holds[i];
+			if (flags[i] & HOLD_START_HIDDEN)
+				hold.startType = HoldNoteType::Hidden;
+
+			if (flags[i] & HOLD_END_HIDDEN)
+				hold.endType = HoldNoteType::Hidden;
+
+			if (flags[i] & HOLD_GUIDE)
+				hold.startType = hold.endType = HoldNoteType::Guide;
 
-			int damageCount = reader.readInt32();
-			score.notes.reserve(damageCount);
-			for (int i = 0; i < damageCount; ++i)
+			hold.start.ease = static_cast<EaseType>(eases[i]);
+			hold.fadeType = static_cast<FadeType>(fadeTypes[i]);
+			hold.guideColor = static_cast<GuideColor>(guideColors[i]);
+
+			int startIndex = noteIndex++;
+			hold.start.ID = startIndex;
+
+			hold.steps.reserve(stepCounts[i]);
+			for (uint32_t j = 0; j < stepCounts[i]; ++j, ++stepIndex)
 			{
-				Note note = readNote(NoteType::Damage, &reader, cyanvasVersion);
-				note.ID = nextID++;
-				score.notes[note.ID] = note;
+				section.notes[noteIndex].parentID = startIndex;
+
+				HoldStep step{};
+				step.type = static_cast<HoldStepType>(stepTypes[stepIndex]);
+				step.ease = static_cast<EaseType>(stepEases[stepIndex]);
+				step.ID = noteIndex++;
+				hold.steps.push_back(step);
 			}
+
+			section.notes[noteIndex].parentID = startIndex;
+			hold.end = noteIndex++;
 		}
 
+		return section;
+	}
+
+	NoteSection readNoteSection(const BinaryReader& reader, uint32_t address, NoteType type,
+	                            int version, int cyanvasVersion)
+	{
+		BinaryReader sectionReader = reader.readerAt(address);
+		if (type == NoteType::Hold)
+			return cyanvasVersion >= 6 ? readHoldColumnSection(&sectionReader)
+			                           : readHolds(&sectionReader, version, cyanvasVersion);
+
+		return cyanvasVersion >= 6 ? readNoteColumnSection(&sectionReader, type)
+		                           : readNotes(&sectionReader, type, cyanvasVersion);
+	}
+
+	struct ScoreFileHeader
+	{
+		int version;
+		int cyanvasVersion;
+		uint32_t metadataAddress;
+		uint32_t eventsAddress;
+		uint32_t tapsAddress;
+		uint32_t holdsAddress;
+		uint32_t damagesAddress;
+		uint32_t layersAddress;
+		uint32_t waypointsAddress;
+	};
+
+	ScoreFileHeader readHeader(BinaryReader* reader)
+	{
+		std::string_view signature = reader->readStringView();
+		if (signature != "MMWS" && signature != "CCMMWS")
+			throw std::runtime_error("Not a MMWS file.");
+
+		bool isCyanvas = signature == "CCMMWS";
+
+		ScoreFileHeader header{};
+		header.version = reader->readInt16();
+		header.cyanvasVersion = reader->readInt16();
+		if (isCyanvas && header.cyanvasVersion == 0)
+		{
+			header.cyanvasVersion = 1;
+		}
+
+		if (header.version > 2)
+		{
+			header.metadataAddress = reader->readInt32();
+			header.eventsAddress = reader->readInt32();
+			header.tapsAddress = reader->readInt32();
+			header.holdsAddress = reader->readInt32();
+			if (isCyanvas)
+				header.damagesAddress = reader->readInt32();
+			if (header.cyanvasVersion >= 4)
+				header.layersAddress = reader->readInt32();
+			if (header.cyanvasVersion >= 5)
+				header.waypointsAddress = reader->readInt32();
+		}
+
+		return header;
+	}
+
+	ScoreFileInfo readScoreFileInfo(const std::string& filename)
+	{
+		BinaryReader reader(filename, true);
+		if (!reader.isStreamValid())
+			throw std::runtime_error("Failed to open " + filename);
+
+		// Enough for the header and, in files without offsets, the metadata following it
+		reader.load(0, 4096);
+		ScoreFileHeader header = readHeader(&reader);
+
+		ScoreFileInfo info{};
+		info.version = header.version;
+		info.cyanvasVersion = header.cyanvasVersion;
+		info.tapCount = info.holdCount = info.damageCount = -1;
+		if (header.version <= 2)
+		{
+			info.metadata = readMetadata(&reader, header.version, header.cyanvasVersion);
+			return info;
+		}
+
+		reader.load(header.metadataAddress, header.eventsAddress - header.metadataAddress);
+		info.metadata = readMetadata(&reader, header.version, header.cyanvasVersion);
+
+		// Each note section starts with its count
+		auto readCountAt = [&reader](uint32_t address)
+		{
+			reader.load(address, sizeof(uint32_t));
+			return static_cast<int>(reader.readInt32());
+		};
+
+		info.tapCount = readCountAt(header.tapsAddress);
+		info.holdCount = readCountAt(header.holdsAddress);
+		if (header.cyanvasVersion >= 1)
+			info.damageCount = readCountAt(header.damagesAddress);
+
+		return info;
+	}
+
+	Score deserializeScore(const std::string& filename)
+	{
+		Score score;
+		BinaryReader reader(filename);
+		if (!reader.isStreamValid())
+			return score;
+
+		ScoreFileHeader header = readHeader(&reader);
+		int version = header.version;
+		int cyanvasVersion = header.cyanvasVersion;
+		if (version > 2)
+			reader.seek(header.metadataAddress);
+
+		score.metadata = readMetadata(&reader, version, cyanvasVersion);
+
+		if (version > 2)
+			reader.seek(header.eventsAddress);
+
+		readScoreEvents(score, version, cyanvasVersion, &reader);
+
+		NoteSection taps;
+		NoteSection holds;
+		NoteSection damages;
+		if (version > 2)
+		{
+			// The note sections start at known offsets so large files decode them in parallel
+			const std::launch policy = reader.getFileSize() >= parallelDecodeSize
+			                               ? std::launch::async
+			                               : std::launch::deferred;
+
+			auto tapsTask = std::async(policy, readNoteSection, std::cref(reader),
+			                           header.tapsAddress, NoteType::Tap, version, cyanvasVersion);
+			auto holdsTask = std::async(policy, readNoteSection, std::cref(reader),
+			                            header.holdsAddress, NoteType::Hold, version, cyanvasVersion);
+			if (cyanvasVersion >= 1)
+				damages = readNoteSection(reader, header.damagesAddress, NoteType::Damage, version,
+				                          cyanvasVersion);
+
+			taps = tapsTask.get();
+			holds = holdsTask.get();
+		}
+		else
+		{
+			taps = readNotes(&reader, NoteType::Tap, cyanvasVersion);
+			holds = readHolds(&reader, version, cyanvasVersion);
+		}
+
+		// Merged in file order so notes get the same IDs as when read sequentially
+		mergeNoteSection(score, taps);
+		mergeNoteSection(score, holds);
+		mergeNoteSection(score, damages);
+
 		if (cyanvasVersion >= 4)
 		{
 			score.layers.clear();
-			reader.seek(layersAddress);
+			reader.seek(header.layersAddress);
 
 			int layerCount = reader.readInt32();
 			score.layers.reserve(layerCount);
@@ -355,7 +948,7 @@ namespace MikuMikuWorld
 		if (cyanvasVersion >= 5)
 		{
 			score.waypoints.clear();
-			reader.seek(waypointsAddress);
+			reader.seek(header.waypointsAddress);
 
 			int waypointCount = reader.readInt32();
 			score.waypoints.reserve(waypointCount);
@@ -374,8 +967,9 @@ namespace MikuMikuWorld
 	void serializeScore(const Score& score, const std::string& filename)
 	{
 		BinaryWriter writer(filename);
-		if (!writer.isStreamValid())
-			return;
+
+		// Notes take about 6 bytes each in the columnar layout
+		writer.reserve(score.notes.size() * 8 + 1024);
 
 		// signature
 		writer.writeString("CCMMWS");
@@ -383,7 +977,7 @@ namespace MikuMikuWorld
 		// verison
 		writer.writeInt16(4);
 		// cyanvas version
-		writer.writeInt16(5);
+		writer.writeInt16(6);
 
 		// offsets address in order: metadata -> events -> taps -> holds
 		// Cyanvas extension: -> damages -> layers -> waypoints
@@ -396,112 +990,267 @@ namespace MikuMikuWorld
 		uint32_t eventsAddress = writer.getStreamPosition();
 		writeScoreEvents(score, &writer);
 
+		// Notes are written in tick order so the tick deltas stay small
+		std::vector<const Note*> taps;
+		std::vector<const Note*> damages;
+		for (int id : canonicalNoteOrder(score))
+		{
+			const Note& note = score.notes.at(id);
+			if (note.getType() == NoteType::Tap)
+				taps.push_back(&note);
+			else
+				damages.push_back(&note);
+		}
+
+		std::vector<int> holdIDs = canonicalHoldOrder(score);
+
 		uint32_t tapsAddress = writer.getStreamPosition();
-		writer.writeNull(sizeof(uint32_t));
+		writer.writeInt32(taps.size());
+		writeNoteColumns(taps, &writer);
+
+		uint32_t holdsAddress = writer.getStreamPosition();
+		writeHoldColumnSection(score.notes, score.holdNotes, holdIDs, &writer);
+
+		// Cyanvas extension: write damages
+		uint32_t damagesAddress = writer.getStreamPosition();
+		writer.writeInt32(damages.size());
+		writeNoteColumns(damages, &writer);
+
+		// Cyanvas extension: write layers
+		uint32_t layersAddress = writer.getStreamPosition();
 
-		int noteCount = 0;
-		for (const auto& [id, note] : score.notes)
+		writer.writeInt32(score.layers.size());
+
+		for (const auto& layer : score.layers)
 		{
-			if (note.getType() != NoteType::Tap)
-				continue;
+			writer.writeString(layer.name);
+		}
 
-			writeNote(note, &writer);
-			++noteCount;
+		uint32_t waypointsAddress = writer.getStreamPosition();
+
+		writer.writeInt32(score.waypoints.size());
+
+		for (const auto& waypoint : score.waypoints)
+		{
+			writer.writeString(waypoint.name);
+			writer.writeInt32(waypoint.tick);
 		}
+		// write offset addresses
+		const uint32_t addresses[] = { metadataAddress, eventsAddress,  tapsAddress,
+			                           holdsAddress,    damagesAddress, layersAddress,
+			                           waypointsAddress };
+		for (size_t i = 0; i < std::size(addresses); ++i)
+			writer.patchInt32(offsetsAddress + sizeof(uint32_t) * i, addresses[i]);
 
-		uint32_t holdsAddress = writer.getStreamPosition();
+		writer.flush();
+	}
 
-		// write taps count
-		writer.seek(tapsAddress);
-		writer.writeInt32(noteCount);
+	// Version of the clipboard data, the first byte written
+	constexpr uint8_t clipboardVersion = 1;
 
-		writer.seek(holdsAddress);
+	ClipboardData copyNoteSelection(const Score& score, const std::unordered_set<int>& selection,
+	                                const std::unordered_set<int>& hiSpeedSelection, int baseTick)
+	{
+		ClipboardData data;
+		std::unordered_set<int> holdIDs;
+		int nextID = 0;
 
-		writer.writeInt32(score.holdNotes.size());
-		for (const auto& [id, hold] : score.holdNotes)
+		auto copyNote = [&nextID, baseTick](const Note& note)
 		{
-			unsigned int flags{};
-			if (hold.startType == HoldNoteType::Guide)
-				flags |= HOLD_GUIDE;
-			if (hold.startType == HoldNoteType::Hidden)
-				flags |= HOLD_START_HIDDEN;
-			if (hold.endType == HoldNoteType::Hidden)
-				flags |= HOLD_END_HIDDEN;
-			writer.writeInt32(flags);
-
-			// note data
-			const Note& start = score.notes.at(hold.start.ID);
-			writeNote(start, &writer);
-			writer.writeInt32((int)hold.start.ease);
-			writer.writeInt32((int)hold.fadeType);
-			writer.writeInt32((int)hold.guideColor);
-
-			// steps
-			int stepCount = hold.steps.size();
-			writer.writeInt32(stepCount);
-			for (const auto& step : hold.steps)
+			Note copy = note;
+			copy.ID = nextID++;
+			copy.tick -= baseTick;
+			return copy;
+		};
+
+		for (int id : selection)
+		{
+			auto it = score.notes.find(id);
+			if (it == score.notes.end())
+				continue;
+
+			const Note& note = it->second;
+			switch (note.getType())
 			{
-				const Note& mid = score.notes.at(step.ID);
-				writeNote(mid, &writer);
-				writer.writeInt32((int)step.type);
-				writer.writeInt32((int)step.ease);
+			case NoteType::Tap:
+			{
+				Note copy = copyNote(note);
+				data.notes[copy.ID] = copy;
+				break;
+			}
+			case NoteType::Damage:
+			{
+				Note copy = copyNote(note);
+				data.damages[copy.ID] = copy;
+				break;
+			}
+			case NoteType::Hold:
+				holdIDs.insert(note.ID);
+				break;
+			case NoteType::HoldMid:
+			case NoteType::HoldEnd:
+				holdIDs.insert(note.parentID);
+				break;
+			default:
+				break;
 			}
-
-			// end
-			const Note& end = score.notes.at(hold.end);
-			writeNote(end, &writer);
 		}
 
-		uint32_t damagesAddress = writer.getStreamPosition();
-		writer.writeNull(sizeof(uint32_t));
+		for (int id : holdIDs)
+		{
+			HoldNote hold = score.holdNotes.at(id);
+			Note start = copyNote(score.notes.at(hold.start.ID));
+			start.flick = FlickType::None;
+			data.notes[start.ID] = start;
 
-		// Cyanvas extension: write damages
-		int damageNoteCount = 0;
-		for (const auto& [id, note] : score.notes)
+			Note end = copyNote(score.notes.at(hold.end));
+			end.parentID = start.ID;
+			end.critical = start.critical || ((end.isFlick() || end.friction) && end.critical);
+			data.notes[end.ID] = end;
+
+			for (HoldStep& step : hold.steps)
+			{
+				Note mid = copyNote(score.notes.at(step.ID));
+				mid.parentID = start.ID;
+				mid.critical = start.critical;
+				mid.friction = false;
+				mid.flick = FlickType::None;
+				data.notes[mid.ID] = mid;
+				step.ID = mid.ID;
+			}
+
+			hold.start.ID = start.ID;
+			hold.start.type = HoldStepType::Normal;
+			hold.end = end.ID;
+			if (hold.isGuide())
+				hold.startType = hold.endType = HoldNoteType::Guide;
+
+			data.holds[hold.start.ID] = std::move(hold);
+		}
+
+		int nextHiSpeedID = 0;
+		for (int id : hiSpeedSelection)
 		{
-			if (note.getType() != NoteType::Damage)
-				continue;
+			const HiSpeedChange& hiSpeed = score.hiSpeedChanges.at(id);
+			HiSpeedChange copy{ nextHiSpeedID++, hiSpeed.tick - baseTick, hiSpeed.speed };
+			data.hiSpeedChanges[copy.ID] = copy;
+		}
+
+		return data;
+	}
 
-			writeNote(note, &writer);
-			++damageNoteCount;
+	void writeClipboardData(const ClipboardData& data, BinaryWriter* writer)
+	{
+		writer->writeInt8(clipboardVersion);
+
+		// Notes are written in tick order so the tick deltas stay small
+		auto byTick = [](const Note* a, const Note* b) { return a->tick < b->tick; };
+		std::vector<const Note*> taps;
+		for (const auto& [_, note] : data.notes)
+			if (note.getType() == NoteType::Tap)
+				taps.push_back(&note);
+
+		std::sort(taps.begin(), taps.end(), byTick);
+		writer->writeInt32(taps.size());
+		writeNoteColumns(taps, writer);
+
+		std::vector<int> holdIDs;
+		holdIDs.reserve(data.holds.size());
+		for (const auto& [id, _] : data.holds)
+			holdIDs.push_back(id);
+
+		std::sort(holdIDs.begin(), holdIDs.end(), [&data](int a, int b)
+		          { return data.notes.at(a).tick < data.notes.at(b).tick; });
+		writeHoldColumnSection(data.notes, data.holds, holdIDs, writer);
+
+		std::vector<const Note*> damages;
+		for (const auto& [_, note] : data.damages)
+			damages.push_back(&note);
+
+		std::sort(damages.begin(), damages.end(), byTick);
+		writer->writeInt32(damages.size());
+		writeNoteColumns(damages, writer);
+
+		std::vector<const HiSpeedChange*> hiSpeeds;
+		for (const auto& [_, hiSpeed] : data.hiSpeedChanges)
+			hiSpeeds.push_back(&hiSpeed);
+
+		std::sort(hiSpeeds.begin(), hiSpeeds.end(),
+		          [](const HiSpeedChange* a, const HiSpeedChange* b) { return a->tick < b->tick; });
+
+		writer->writeInt32(hiSpeeds.size());
+		int previousTick = 0;
+		for (const HiSpeedChange* hiSpeed : hiSpeeds)
+		{
+			writer->writeVarInt(zigzagEncode(hiSpeed->tick - previousTick));
+			previousTick = hiSpeed->tick;
 		}
 
-		// Cyanvas extension: write layers
-		uint32_t layersAddress = writer.getStreamPosition();
+		for (const HiSpeedChange* hiSpeed : hiSpeeds)
+			writer->writeSingle(hiSpeed->speed);
+	}
 
-		// write damages count
-		writer.seek(damagesAddress);
-		writer.writeInt32(damageNoteCount);
+	ClipboardData readClipboardData(BinaryReader* reader)
+	{
+		if (reader->readInt8() != clipboardVersion)
+			throw std::runtime_error("Unsupported clipboard data.");
 
-		writer.seek(layersAddress);
+		NoteSection taps = readNoteColumnSection(reader, NoteType::Tap);
+		NoteSection holds = readHoldColumnSection(reader);
+		NoteSection damages = readNoteColumnSection(reader, NoteType::Damage);
 
-		writer.writeInt32(score.layers.size());
+		ClipboardData data;
+		data.notes.reserve(taps.notes.size() + holds.notes.size());
+		int nextID = 0;
+		for (Note& note : taps.notes)
+		{
+			note.ID = nextID++;
+			data.notes[note.ID] = note;
+		}
 
-		for (const auto& layer : score.layers)
+		// Hold note IDs and references are indices into the section
+		const int firstHoldID = nextID;
+		for (Note& note : holds.notes)
 		{
-			writer.writeString(layer.name);
+			note.ID = nextID++;
+			if (note.parentID != -1)
+				note.parentID += firstHoldID;
+
+			data.notes[note.ID] = note;
 		}
 
-		uint32_t waypointsAddress = writer.getStreamPosition();
+		for (HoldNote& hold : holds.holds)
+		{
+			hold.start.ID += firstHoldID;
+			for (HoldStep& step : hold.steps)
+				step.ID += firstHoldID;
 
-		writer.writeInt32(score.waypoints.size());
+			hold.end += firstHoldID;
+			data.holds[hold.start.ID] = std::move(hold);
+		}
 
-		for (const auto& waypoint : score.waypoints)
+		data.damages.reserve(damages.notes.size());
+		for (Note& note : damages.notes)
 		{
-			writer.writeString(waypoint.name);
-			writer.writeInt32(waypoint.tick);
+			note.ID = nextID++;
+			data.damages[note.ID] = note;
 		}
-		// write offset addresses
-		writer.seek(offsetsAddress);
-		writer.writeInt32(metadataAddress);
-		writer.writeInt32(eventsAddress);
-		writer.writeInt32(tapsAddress);
-		writer.writeInt32(holdsAddress);
-		writer.writeInt32(damagesAddress);
-		writer.writeInt32(layersAddress);
-		writer.writeInt32(waypointsAddress);
 
-		writer.flush();
-		writer.close();
+		size_t hiSpeedCount = readCount(reader);
+		std::vector<int> ticks(hiSpeedCount);
+		int tick = 0;
+		for (int& hiSpeedTick : ticks)
+		{
+			tick += zigzagDecode(reader->readVarInt());
+			hiSpeedTick = tick;
+		}
+
+		for (size_t i = 0; i < hiSpeedCount; ++i)
+		{
+			HiSpeedChange hiSpeed{ static_cast<int>(i), ticks[i], reader->readSingle() };
+			data.hiSpeedChanges[hiSpeed.ID] = hiSpeed;
+		}
+
+		return data;
 	}
 }
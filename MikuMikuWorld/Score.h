@@ -1,16 +1,21 @@
 #pragma once
 #include "Note.h"
+#include "ScoreIndex.h"
 #include "Tempo.h"
 #include <map>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
-namespace MikuMikuWorld
+namespace IO
 {
-	extern int nextSkillID;
-	extern int nextHiSpeedID;
+	class BinaryReader;
+	class BinaryWriter;
+}
 
+namespace MikuMikuWorld
+{
 	struct SkillTrigger
 	{
 		int ID;
@@ -57,7 +62,7 @@ namespace MikuMikuWorld
 	struct Score
 	{
 		ScoreMetadata metadata;
-		std::unordered_map<int, Note> notes;
+		SlotMap<Note> notes;
 		std::unordered_map<int, HoldNote> holdNotes;
 		std::vector<Tempo> tempoChanges;
 		std::map<int, TimeSignature> timeSignatures;
@@ -69,8 +74,131 @@ namespace MikuMikuWorld
 		std::vector<Waypoint> waypoints;
 
 		Score();
+
+		// IDs are allocated per score so separate scores can be built on different threads
+		inline int allocateNoteID() { return nextNoteID++; }
+		inline int allocateHiSpeedID() { return nextHiSpeedID++; }
+		inline int allocateSkillID() { return nextSkillID++; }
+
+		// Reserves count consecutive IDs and returns the first one
+		int allocateNoteIDs(int count);
+		int allocateHiSpeedIDs(int count);
+
+		// IDs of notes with a tick in the range [begin, end], ordered by tick
+		std::vector<int> notesInTickRange(int begin, int end) const;
+
+		// IDs of holds with any part in the range [begin, end]
+		std::vector<int> holdsInTickRange(int begin, int end) const;
+
+		// Must be called after editing notes or holds outside of moveNoteTick.
+		// Also invalidates the note columns
+		void invalidateTickIndex();
+
+		// Path segments of a hold, resolved again only after the hold is invalidated
+		const std::vector<HoldSegment>& getHoldSegments(int holdID) const;
+
+		// Must be called after changing a hold or the lane or width of its notes outside of an
+		// edit. Edits recorded in the history invalidate the holds they changed
+		void invalidateHoldGeometry(int holdID);
+
+		// Invalidates the hold the note belongs to, if any
+		void invalidateHoldGeometry(const Note& note);
+
+		// Keeps the tick index current when a single note is moved
+		void moveNoteTick(Note& note, int tick);
+
+		// Columnar copy of the notes for passes over the whole score
+		const NoteColumns& getNoteColumns() const;
+
+		const TempoMap& getTempoMap() const;
+
+		// Must be called after editing tempo changes
+		void invalidateTempoMap();
+
+		const MeasureTable& getMeasureTable() const;
+
+		// Must be called after editing time signatures
+		void invalidateMeasureTable();
+
+		// ID of the hi-speed change active at tick or -1. A layer of -1 searches all layers
+		int findHiSpeedChange(int tick, int layer) const;
+
+		// IDs of hi-speed changes with a tick in the range [begin, end], ordered by tick
+		std::vector<int> hiSpeedChangesInTickRange(int begin, int end, int layer) const;
+
+		// Keep the hi-speed index current when adding, removing or moving a hi-speed change
+		void addHiSpeedChange(const HiSpeedChange& hiSpeed);
+		void eraseHiSpeedChange(int id);
+		void moveHiSpeedChange(HiSpeedChange& hiSpeed, int tick);
+
+		// Must be called after changing the layer of hi-speed changes
+		void invalidateHiSpeedIndex();
+
+	  private:
+		int nextNoteID{ 1 };
+		int nextHiSpeedID{ 1 };
+		int nextSkillID{ 1 };
+
+		// Lookup structures derived from the score. Copying a score leaves them to be rebuilt
+		// on demand instead of duplicating them along with the data they were built from.
+		struct Caches
+		{
+			NoteTickIndex noteTickIndex;
+			HoldTickIndex holdTickIndex;
+			NoteColumns noteColumns;
+			HoldGeometryCache holdGeometry;
+			TempoMap tempoMap;
+			MeasureTable measureTable;
+			HiSpeedIndex hiSpeedIndex;
+
+			Caches() = default;
+			Caches(const Caches&) {}
+			Caches(Caches&&) = default;
+			Caches& operator=(const Caches&) { return *this = Caches{}; }
+			Caches& operator=(Caches&&) = default;
+		};
+
+		mutable Caches caches;
 	};
 
+	// Header of a MMWS file. Counts are -1 in files older than version 3, which have no offsets
+	struct ScoreFileInfo
+	{
+		int version;
+		int cyanvasVersion;
+		ScoreMetadata metadata;
+		int tapCount;
+		int holdCount;
+		int damageCount;
+	};
+
+	// Reads only the header, metadata and note counts of a MMWS file without loading the score
+	ScoreFileInfo readScoreFileInfo(const std::string& filename);
+
+	// IDs of taps and damages, and of holds, in the order they are saved in. They are sorted by
+	// tick and ties are ordered by their properties, so the order does not depend on IDs
+	std::vector<int> canonicalNoteOrder(const Score& score);
+	std::vector<int> canonicalHoldOrder(const Score& score);
+
 	Score deserializeScore(const std::string& filename);
 	void serializeScore(const Score& score, const std::string& filename);
+
+	// Notes and hi-speed changes of a copied selection. IDs start from 0 and ticks are relative
+	// to the start of the selection. Taps share notes with the notes of holds
+	struct ClipboardData
+	{
+		SlotMap<Note> notes;
+		std::unordered_map<int, HoldNote> holds;
+		SlotMap<Note> damages;
+		std::unordered_map<int, HiSpeedChange> hiSpeedChanges;
+	};
+
+	// Copies the selected notes, including the whole hold of any selected hold note, with the
+	// same properties a JSON copy pastes back with
+	ClipboardData copyNoteSelection(const Score& score, const std::unordered_set<int>& selection,
+	                                const std::unordered_set<int>& hiSpeedSelection, int baseTick);
+
+	// Encoded with the same note columns as score files
+	void writeClipboardData(const ClipboardData& data, IO::BinaryWriter* writer);
+	ClipboardData readClipboardData(IO::BinaryReader* reader);
 }
@@ -1,4 +1,7 @@
 #include "ScoreContext.h"
+#include "ApplicationConfiguration.h"
+#include "BinaryReader.h"
+#include "BinaryWriter.h"
 #include "Constants.h"
 #include "IO.h"
 #include "UI.h"
@@ -11,7 +14,10 @@ using namespace IO;
 
 namespace MikuMikuWorld
 {
-	constexpr const char* clipboardSignature = "MikuMikuWorld clipboard\n";
+	constexpr const char* clipboardSignature = "MikuMikuWorld clipboard data\n";
+
+	// Copies from older versions are JSON text
+	constexpr const char* jsonClipboardSignature = "MikuMikuWorld clipboard\n";
 
 	void ScoreContext::setStep(HoldStepType type)
 	{
@@ -19,7 +25,6 @@ namespace MikuMikuWorld
 			return;
 
 		bool edit = false;
-		Score prev = score;
 		for (int id : selectedNotes)
 		{
 			const Note& note = score.notes.at(id);
@@ -48,7 +53,7 @@ namespace MikuMikuWorld
 		}
 
 		if (edit)
-			pushHistory("Change step type", prev, score);
+			pushHistory("Change step type");
 	}
 
 	void ScoreContext::setFlick(FlickType flick)
@@ -57,7 +62,6 @@ namespace MikuMikuWorld
 			return;
 
 		bool edit = false;
-		Score prev = score;
 		for (int id : selectedNotes)
 		{
 			Note& note = score.notes.at(id);
@@ -84,7 +88,7 @@ namespace MikuMikuWorld
 		}
 
 		if (edit)
-			pushHistory("Change flick", prev, score);
+			pushHistory("Change flick");
 	}
 
 	void ScoreContext::setEase(EaseType ease)
@@ -93,7 +97,6 @@ namespace MikuMikuWorld
 			return;
 
 		bool edit = false;
-		Score prev = score;
 		for (int id : selectedNotes)
 		{
 			Note& note = score.notes.at(id);
@@ -132,7 +135,7 @@ namespace MikuMikuWorld
 		}
 
 		if (edit)
-			pushHistory("Change ease", prev, score);
+			pushHistory("Change ease");
 	}
 
 	void ScoreContext::setHoldType(HoldNoteType hold)
@@ -140,7 +143,6 @@ namespace MikuMikuWorld
 		if (selectedNotes.empty())
 			return;
 
-		Score prev = score;
 		bool edit = false;
 		for (int id : selectedNotes)
 		{
@@ -178,7 +180,7 @@ namespace MikuMikuWorld
 		}
 
 		if (edit)
-			pushHistory("Change hold", prev, score);
+			pushHistory("Change hold");
 	}
 
 	void ScoreContext::setFadeType(FadeType fade)
@@ -186,7 +188,6 @@ namespace MikuMikuWorld
 		if (selectedNotes.empty())
 			return;
 
-		Score prev = score;
 		bool edit = false;
 		for (int id : selectedNotes)
 		{
@@ -206,7 +207,7 @@ namespace MikuMikuWorld
 		}
 
 		if (edit)
-			pushHistory("Change fade", prev, score);
+			pushHistory("Change fade");
 	}
 
 	void ScoreContext::setGuideColor(GuideColor color)
@@ -214,7 +215,6 @@ namespace MikuMikuWorld
 		if (selectedNotes.empty())
 			return;
 
-		Score prev = score;
 		bool edit = false;
 		for (int id : selectedNotes)
 		{
@@ -246,7 +246,7 @@ namespace MikuMikuWorld
 		}
 
 		if (edit)
-			pushHistory("Change guide", prev, score);
+			pushHistory("Change guide");
 	}
 
 	void ScoreContext::setLayer(int layer)
@@ -255,7 +255,6 @@ namespace MikuMikuWorld
 			return;
 
 		bool edit = false;
-		Score prev = score;
 		for (int id : selectedNotes)
 		{
 			Note& note = score.notes.at(id);
@@ -267,7 +266,7 @@ namespace MikuMikuWorld
 		}
 
 		if (edit)
-			pushHistory("Change layer", prev, score);
+			pushHistory("Change layer");
 	}
 
 	void ScoreContext::toggleCriticals()
@@ -275,7 +274,6 @@ namespace MikuMikuWorld
 		if (selectedNotes.empty())
 			return;
 
-		Score prev = score;
 		std::unordered_set<int> critHolds;
 		for (int id : selectedNotes)
 		{
@@ -325,7 +323,7 @@ namespace MikuMikuWorld
 				score.notes.at(step.ID).critical = critical;
 		}
 
-		pushHistory("Change critical note", prev, score);
+		pushHistory("Change critical note");
 	}
 
 	void ScoreContext::toggleFriction()
@@ -333,7 +331,6 @@ namespace MikuMikuWorld
 		if (selectedNotes.empty())
 			return;
 
-		Score prev = score;
 		bool edit = false;
 		for (int id : selectedNotes)
 		{
@@ -369,7 +366,7 @@ namespace MikuMikuWorld
 		}
 
 		if (edit)
-			pushHistory("Change trace notes", prev, score);
+			pushHistory("Change trace notes");
 	}
 
 	void ScoreContext::deleteSelection()
@@ -377,7 +374,6 @@ namespace MikuMikuWorld
 		if (selectedNotes.empty() && selectedHiSpeedChanges.empty())
 			return;
 
-		Score prev = score;
 		for (auto& id : selectedNotes)
 		{
 			auto notePos = score.notes.find(id);
@@ -415,12 +411,12 @@ namespace MikuMikuWorld
 		}
 		for (auto& id : selectedHiSpeedChanges)
 		{
-			score.hiSpeedChanges.erase(id);
+			score.eraseHiSpeedChange(id);
 		}
 
 		selectedNotes.clear();
 		selectedHiSpeedChanges.clear();
-		pushHistory("Delete notes", prev, score);
+		pushHistory("Delete notes");
 	}
 
 	void ScoreContext::flipSelection()
@@ -428,7 +424,6 @@ namespace MikuMikuWorld
 		if (selectedNotes.empty())
 			return;
 
-		Score prev = score;
 		for (int id : selectedNotes)
 		{
 			Note& note = score.notes.at(id);
@@ -440,7 +435,7 @@ namespace MikuMikuWorld
 				note.flick = FlickType::Left;
 		}
 
-		pushHistory("Flip notes", prev, score);
+		pushHistory("Flip notes");
 	}
 
 	void ScoreContext::cutSelection()
@@ -478,13 +473,18 @@ namespace MikuMikuWorld
 			                 .tick);
 		}
 
-		json data =
-		    jsonIO::noteSelectionToJson(score, selectedNotes, selectedHiSpeedChanges, minTick);
+		ClipboardData data =
+		    copyNoteSelection(score, selectedNotes, selectedHiSpeedChanges, minTick);
+
+		BinaryWriter writer;
+		writeClipboardData(data, &writer);
 
 		std::string clipboard{ clipboardSignature };
-		clipboard.append(data.dump());
+		clipboard.append(base64Encode(writer.getBuffer()));
 
 		ImGui::SetClipboardText(clipboard.c_str());
+		copiedData = std::move(data);
+		copiedClipboard = std::move(clipboard);
 	}
 
 	void ScoreContext::cancelPaste() { pasteData.pasting = false; }
@@ -656,6 +656,25 @@ namespace MikuMikuWorld
 			}
 		}
 
+		startPaste(flip);
+	}
+
+	void ScoreContext::doPasteData(ClipboardData data, bool flip)
+	{
+		static_cast<ClipboardData&>(pasteData) = std::move(data);
+		for (auto& [_, note] : pasteData.notes)
+			note.layer = selectedLayer;
+
+		for (auto& [_, note] : pasteData.damages)
+			note.layer = selectedLayer;
+
+		startPaste(flip);
+	}
+
+	void ScoreContext::startPaste(bool flip)
+	{
+		pasteData.version++;
+
 		if (flip)
 		{
 			for (auto& [_, note] : pasteData.notes)
@@ -694,14 +713,16 @@ namespace MikuMikuWorld
 
 	void ScoreContext::confirmPaste()
 	{
-		Score prev = score;
+		const int baseNoteID =
+		    score.allocateNoteIDs(pasteData.notes.size() + pasteData.damages.size());
+		const int baseHiSpeedID = score.allocateHiSpeedIDs(pasteData.hiSpeedChanges.size());
 
 		// update IDs and copy notes
 		for (auto& [_, note] : pasteData.notes)
 		{
-			note.ID += nextID;
+			note.ID += baseNoteID;
 			if (note.parentID != -1)
-				note.parentID += nextID;
+				note.parentID += baseNoteID;
 
 			note.lane += pasteData.offsetLane;
 			note.tick += pasteData.offsetTicks;
@@ -711,9 +732,9 @@ namespace MikuMikuWorld
 
 		for (auto& [_, note] : pasteData.damages)
 		{
-			note.ID += nextID;
+			note.ID += baseNoteID;
 			if (note.parentID != -1)
-				note.parentID += nextID;
+				note.parentID += baseNoteID;
 
 			note.lane += pasteData.offsetLane;
 			note.tick += pasteData.offsetTicks;
@@ -722,20 +743,20 @@ namespace MikuMikuWorld
 		}
 		for (auto& [_, hold] : pasteData.holds)
 		{
-			hold.start.ID += nextID;
-			hold.end += nextID;
+			hold.start.ID += baseNoteID;
+			hold.end += baseNoteID;
 			for (auto& step : hold.steps)
-				step.ID += nextID;
+				step.ID += baseNoteID;
 
 			score.holdNotes[hold.start.ID] = hold;
 		}
 
 		for (auto& [_, hsc] : pasteData.hiSpeedChanges)
 		{
-			hsc.ID += nextHiSpeedID;
+			hsc.ID += baseHiSpeedID;
 			hsc.layer = selectedLayer;
 			hsc.tick += pasteData.offsetTicks;
-			score.hiSpeedChanges[hsc.ID] = hsc;
+			score.addHiSpeedChange(hsc);
 		}
 
 		// select newly pasted notes
@@ -751,10 +772,8 @@ namespace MikuMikuWorld
 		               std::inserter(selectedHiSpeedChanges, selectedHiSpeedChanges.end()),
 		               [this](const auto& it) { return it.second.ID; });
 
-		nextID += pasteData.notes.size() + pasteData.damages.size();
-		nextHiSpeedID += pasteData.hiSpeedChanges.size();
 		pasteData.pasting = false;
-		pushHistory("Paste notes", prev, score);
+		pushHistory("Paste notes");
 	}
 
 	void ScoreContext::paste(bool flip)
@@ -763,11 +782,23 @@ namespace MikuMikuWorld
 		if (clipboardDataPtr == nullptr)
 			return;
 
-		std::string clipboardData(clipboardDataPtr);
-		if (!startsWith(clipboardData, clipboardSignature))
-			return;
+		std::string_view clipboardData(clipboardDataPtr);
+		if (!copiedClipboard.empty() && clipboardData == copiedClipboard)
+		{
+			doPasteData(copiedData, flip);
+		}
+		else if (startsWith(clipboardData, clipboardSignature))
+		{
+			std::vector<uint8_t> payload =
+			    base64Decode(clipboardData.substr(strlen(clipboardSignature)));
 
-		doPasteData(json::parse(clipboardData.substr(strlen(clipboardSignature))), flip);
+			BinaryReader reader(payload.data(), payload.size());
+			doPasteData(readClipboardData(&reader), flip);
+		}
+		else if (startsWith(clipboardData, jsonClipboardSignature))
+		{
+			doPasteData(json::parse(clipboardData.substr(strlen(jsonClipboardSignature))), flip);
+		}
 	}
 
 	void ScoreContext::shrinkSelection(Direction direction)
@@ -781,7 +812,6 @@ namespace MikuMikuWorld
 			HiSpeed
 		};
 
-		Score prev = score;
 
 		std::vector<std::pair<Type, int>> sortedSelection;
 		for (auto noteID : selectedNotes)
@@ -824,7 +854,7 @@ namespace MikuMikuWorld
 			else
 			{
 				HiSpeedChange& hsc = score.hiSpeedChanges.at(sortedSelection[i].second);
-				hsc.tick = firstTick + (i * factor);
+				score.moveHiSpeedChange(hsc, firstTick + (i * factor));
 			}
 		}
 
@@ -832,7 +862,7 @@ namespace MikuMikuWorld
 		for (const auto& hold : holds)
 			sortHoldSteps(score, score.holdNotes.at(hold));
 
-		pushHistory("Shrink notes", prev, score);
+		pushHistory("Shrink notes");
 	}
 
 	void ScoreContext::connectHoldsInSelection()
@@ -840,7 +870,6 @@ namespace MikuMikuWorld
 		if (!selectionCanConnect())
 			return;
 
-		Score prev = score;
 		Note& note1 = score.notes[*selectedNotes.begin()];
 		Note& note2 = score.notes[*std::next(selectedNotes.begin())];
 
@@ -881,16 +910,20 @@ namespace MikuMikuWorld
 		// Create new steps to connect both ends
 		Note earlierNoteAsMid =
 		    Note(NoteType::HoldMid, earlierNote.tick, earlierNote.lane, earlierNote.width);
-		earlierNoteAsMid.ID = nextID++;
+		earlierNoteAsMid.ID = score.allocateNoteID();
 		earlierNoteAsMid.critical = earlierHoldStart.critical;
 		earlierNoteAsMid.parentID = earlierHold.start.ID;
 
 		Note laterNoteAsMid =
 		    Note(NoteType::HoldMid, laterNote.tick, laterNote.lane, laterNote.width);
-		laterNoteAsMid.ID = nextID++;
+		laterNoteAsMid.ID = score.allocateNoteID();
 		laterNoteAsMid.critical = earlierHoldStart.critical;
 		laterNoteAsMid.parentID = earlierHold.start.ID;
 
+		// Inserting notes may relocate the existing ones
+		const int earlierNoteID = earlierNote.ID;
+		const int laterNoteID = laterNote.ID;
+
 		// Insert new steps to their appropriate containers
 		score.notes[earlierNoteAsMid.ID] = earlierNoteAsMid;
 		score.notes[laterNoteAsMid.ID] = laterNoteAsMid;
@@ -904,8 +937,8 @@ namespace MikuMikuWorld
 		      laterHold.start.ease });
 
 		// Remove old notes
-		score.notes.erase(earlierNote.ID);
-		score.notes.erase(laterNote.ID);
+		score.notes.erase(earlierNoteID);
+		score.notes.erase(laterNoteID);
 		score.holdNotes.erase(laterHold.start.ID);
 
 		sortHoldSteps(score, earlierHold);
@@ -915,7 +948,7 @@ namespace MikuMikuWorld
 		selectedNotes.insert(earlierNoteAsMid.ID);
 		selectedNotes.insert(laterNoteAsMid.ID);
 
-		pushHistory("Connect holds", prev, score);
+		pushHistory("Connect holds");
 	}
 
 	void ScoreContext::splitHoldInSelection()
@@ -923,7 +956,6 @@ namespace MikuMikuWorld
 		if (selectedNotes.size() != 1)
 			return;
 
-		Score prev = score;
 
 		Note& note = score.notes[*selectedNotes.begin()];
 		if (note.getType() != NoteType::HoldMid)
@@ -938,13 +970,13 @@ namespace MikuMikuWorld
 		Note holdStart = score.notes.at(hold.start.ID);
 
 		Note newSlideEnd = Note(NoteType::HoldEnd, note.tick, note.lane, note.width);
-		newSlideEnd.ID = nextID++;
+		newSlideEnd.ID = score.allocateNoteID();
 		newSlideEnd.parentID = hold.start.ID;
 		newSlideEnd.critical = note.critical;
 		newSlideEnd.layer = holdStart.layer;
 
 		Note newSlideStart = Note(NoteType::Hold, note.tick, note.lane, note.width);
-		newSlideStart.ID = nextID++;
+		newSlideStart.ID = score.allocateNoteID();
 		newSlideStart.critical = holdStart.critical;
 		newSlideStart.layer = holdStart.layer;
 
@@ -984,7 +1016,7 @@ namespace MikuMikuWorld
 		score.notes[newSlideEnd.ID] = newSlideEnd;
 		score.notes[newSlideStart.ID] = newSlideStart;
 		score.holdNotes[newSlideStart.ID] = newHold;
-		pushHistory("Split hold", prev, score);
+		pushHistory("Split hold");
 	}
 
 	void ScoreContext::lerpHiSpeeds(int division) 
@@ -992,15 +1024,15 @@ namespace MikuMikuWorld
 		if (selectedHiSpeedChanges.size() < 2)
 			return;
 
-		Score prev = score;
 
+		// Collect the selection in tick order from the hi-speed index
 		std::vector<int> sortedSelection;
-		sortedSelection.insert(sortedSelection.end(), selectedHiSpeedChanges.begin(), selectedHiSpeedChanges.end());
-		std::sort(sortedSelection.begin(), sortedSelection.end(),
-		          [this](int a, int b)
-		          { 
-					return score.hiSpeedChanges[a].tick < score.hiSpeedChanges[b].tick;
-		          });
+		for (int id : score.hiSpeedChangesInTickRange(INT_MIN, INT_MAX, -1))
+			if (selectedHiSpeedChanges.find(id) != selectedHiSpeedChanges.end())
+				sortedSelection.push_back(id);
+
+		if (sortedSelection.size() < 2)
+			return;
 
 		for (int i = 0; i < sortedSelection.size() - 1; i++)
 		{
@@ -1018,19 +1050,19 @@ namespace MikuMikuWorld
 				    (float)first.speed + t * ((float)second.speed - (float)first.speed); // lerp
 				// remapping the current tick to the speed
 
-				int id = nextHiSpeedID++;
-				score.hiSpeedChanges[id] = { id, tick, speed, selectedLayer };
+				int id = score.allocateHiSpeedID();
+				score.addHiSpeedChange({ id, tick, speed, selectedLayer });
 			}
 		}
 
-		pushHistory("Lerp hispeeds", prev, score);
+		pushHistory("Lerp hispeeds");
 	}
 
 	void ScoreContext::undo()
 	{
 		if (history.hasUndo())
 		{
-			score = history.undo();
+			history.undo(score);
 			clearSelection();
 
 			UI::setWindowTitle((workingData.filename.size()
@@ -1047,7 +1079,7 @@ namespace MikuMikuWorld
 	{
 		if (history.hasRedo())
 		{
-			score = history.redo();
+			history.redo(score);
 			clearSelection();
 
 			UI::setWindowTitle((workingData.filename.size()
@@ -1060,9 +1092,13 @@ namespace MikuMikuWorld
 		}
 	}
 
-	void ScoreContext::pushHistory(std::string description, const Score& prev, const Score& curr)
+	void ScoreContext::pushHistory(const std::string& description)
 	{
-		history.pushHistory(description, prev, curr);
+		// Edits don't maintain the tick index so it is invalidated before the score is recorded
+		score.invalidateTickIndex();
+		history.setMemoryLimit(static_cast<size_t>(std::max(config.historyMemoryLimit, 1)) *
+		                       1024 * 1024);
+		history.pushHistory(description, score);
 
 		UI::setWindowTitle((workingData.filename.size() ? File::getFilename(workingData.filename)
 		                                                : windowUntitled) +
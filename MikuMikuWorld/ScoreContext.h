@@ -53,12 +53,10 @@ namespace MikuMikuWorld
 		}
 	};
 
-	struct PasteData
+	struct PasteData : ClipboardData
 	{
-		std::unordered_map<int, Note> notes;
-		std::unordered_map<int, HoldNote> holds;
-		std::unordered_map<int, Note> damages;
-		std::unordered_map<int, HiSpeedChange> hiSpeedChanges;
+		// Incremented for every paste so previews of the previous data are discarded
+		unsigned int version{};
 		bool pasting{ false };
 		int offsetTicks{};
 		int offsetLane{};
@@ -104,7 +102,7 @@ namespace MikuMikuWorld
 
 		double getTimeAtCurrentTick() const
 		{
-			return accumulateDuration(currentTick, TICKS_PER_BEAT, score.tempoChanges);
+			return score.getTempoMap().ticksToSeconds(currentTick);
 		}
 
 		bool selectionHasEase() const;
@@ -141,6 +139,7 @@ namespace MikuMikuWorld
 		void copySelection();
 		void paste(bool flip);
 		void doPasteData(const nlohmann::json& data, bool flip);
+		void doPasteData(ClipboardData data, bool flip);
 		void cancelPaste();
 		void confirmPaste();
 		void shrinkSelection(Direction direction);
@@ -152,6 +151,16 @@ namespace MikuMikuWorld
 
 		void undo();
 		void redo();
-		void pushHistory(std::string description, const Score& prev, const Score& current);
+
+		// Records the edits made to the score since the last call
+		void pushHistory(const std::string& description);
+
+	  private:
+		// The last copy and the clipboard text it was written as. While the clipboard still
+		// holds that text, pasting uses the copy instead of decoding the text
+		ClipboardData copiedData;
+		std::string copiedClipboard;
+
+		void startPaste(bool flip);
 	};
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include "JsonIO.h"
 
@@ -13,13 +14,12 @@ namespace MikuMikuWorld
 	{
 	private:
 		static std::pair<int, int> barLengthToFraction(float length, float fractionDenom);
-		static std::string noteKey(const SUSNote& note);
-		static std::string noteKey(const Note& note);
+		static uint64_t noteKey(const SUSNote& note);
+		static uint64_t noteKey(const Note& note);
 
 	public:
 		static Score susToScore(const SUS& sus);
 		static SUS scoreToSus(const Score& score);
     static nlohmann::json scoreToUsc(const Score& score);
-    static Score uscToScore(const nlohmann::json& usc);
 	};
 }
@@ -7,10 +7,11 @@
 #include "SusExporter.h"
 #include "SusParser.h"
 #include "UI.h"
+#include "UscParser.h"
+#include "UscWriter.h"
 #include "Utilities.h"
 #include <Windows.h>
 #include <filesystem>
-#include <fstream>
 
 using nlohmann::json;
 
@@ -247,13 +248,60 @@ namespace MikuMikuWorld
 		return config.recentFiles.size();
 	}
 
+	const ScoreFileInfo* ScoreEditor::getRecentFileInfo(const std::string& filename)
+	{
+		auto it = recentFileInfos.find(filename);
+		if (it == recentFileInfos.end())
+		{
+			std::string extension = IO::File::getFileExtension(filename);
+			std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+			std::optional<ScoreFileInfo> info;
+			if ((extension == MMWS_EXTENSION || extension == CC_MMWS_EXTENSION) &&
+			    IO::File::exists(filename))
+			{
+				try
+				{
+					info = readScoreFileInfo(filename);
+				}
+				catch (const std::exception&)
+				{
+					// Unreadable files are listed without details
+				}
+			}
+
+			it = recentFileInfos.emplace(filename, std::move(info)).first;
+		}
+
+		return it->second ? &*it->second : nullptr;
+	}
+
+	void ScoreEditor::drawScoreFileInfoTooltip(const ScoreFileInfo& info)
+	{
+		ImGui::BeginTooltip();
+		ImGui::Text("%s: %s", getString("title"), info.metadata.title.c_str());
+		ImGui::Text("%s: %s", getString("designer"), info.metadata.author.c_str());
+		ImGui::Text("%s: %s", getString("artist"), info.metadata.artist.c_str());
+
+		if (info.tapCount >= 0)
+		{
+			ImGui::Separator();
+			ImGui::Text("%s: %d", getString("taps"), info.tapCount);
+			ImGui::Text("%s: %d", getString("holds"), info.holdCount);
+			if (info.damageCount >= 0)
+				ImGui::Text("%s: %d", getString("damage"), info.damageCount);
+		}
+
+		ImGui::EndTooltip();
+	}
+
 	void ScoreEditor::create()
 	{
 		timeline.setPlaying(context, false);
 
 		context.score = {};
 		context.workingData = {};
-		context.history.clear();
+		context.history.reset(context.score);
 		context.scoreStats.reset();
 		context.audio.disposeMusic();
 		context.waveformL.clear();
@@ -274,11 +322,8 @@ namespace MikuMikuWorld
 		std::string extension = IO::File::getFileExtension(filename);
 		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
 
-		// Backup next note ID in case of an import failure
-		int nextIdBackup = nextID;
 		try
 		{
-			resetNextID();
 			std::string workingFilename;
 			Score newScore;
 
@@ -289,13 +334,8 @@ namespace MikuMikuWorld
 			}
 			else if (extension == USC_EXTENSION)
 			{
-				std::wstring wFilename = IO::mbToWideStr(filename);
-				std::ifstream uscfile(wFilename);
-				json usc;
-				uscfile >> usc;
-				uscfile.close();
-
-				newScore = ScoreConverter::uscToScore(usc);
+				UscParser uscParser;
+				newScore = uscParser.parse(filename);
 			}
 			else if (extension == MMWS_EXTENSION || extension == CC_MMWS_EXTENSION)
 			{
@@ -304,8 +344,8 @@ namespace MikuMikuWorld
 			}
 
 			context.clearSelection();
-			context.history.clear();
 			context.score = std::move(newScore);
+			context.history.reset(context.score);
 			context.workingData = EditorScoreData(context.score.metadata, workingFilename);
 
 			loadMusic(context.workingData.musicFilename);
@@ -321,7 +361,6 @@ namespace MikuMikuWorld
 		}
 		catch (std::exception& error)
 		{
-			nextID = nextIdBackup;
 			std::string errorMessage = IO::formatString(
 			    "%s\n%s: %s\n%s: %s", getString("error_load_score_file"), getString("score_file"),
 			    filename.c_str(), getString("error"), error.what());
@@ -472,14 +511,8 @@ namespace MikuMikuWorld
 				context.score.metadata = context.workingData.toScoreMetadata();
 				context.score.metadata.laneExtension = oldLaneExtension;
 
-				json usc = ScoreConverter::scoreToUsc(context.score);
-
-				std::wstring wFilename = IO::mbToWideStr(fileDialog.outputFilename);
-				IO::File uscfile(wFilename, L"w");
-
-				uscfile.write(usc.dump(4));
-				uscfile.flush();
-				uscfile.close();
+				UscWriter uscWriter;
+				uscWriter.write(context.score, fileDialog.outputFilename);
 			}
 			catch (std::exception& err)
 			{
@@ -513,7 +546,8 @@ namespace MikuMikuWorld
 				for (size_t index = 0; index < config.recentFiles.size(); index++)
 				{
 					const std::string& entry = config.recentFiles[index];
-					if (ImGui::MenuItem(entry.c_str()))
+					const ScoreFileInfo* info = getRecentFileInfo(entry);
+					if (ImGui::MenuItem(entry.c_str(), info ? info->metadata.title.c_str() : nullptr))
 					{
 						if (IO::File::exists(entry))
 						{
@@ -527,6 +561,9 @@ namespace MikuMikuWorld
 							recentFileNotFoundDialog.open = true;
 						}
 					}
+
+					if (info && ImGui::IsItemHovered())
+						drawScoreFileInfoTooltip(*info);
 				}
 
 				ImGui::Separator();
@@ -536,6 +573,11 @@ namespace MikuMikuWorld
 
 				ImGui::EndMenu();
 			}
+			else
+			{
+				// The files may change while the menu is closed
+				recentFileInfos.clear();
+			}
 
 			ImGui::Separator();
 			if (ImGui::MenuItem(getString("save"), ToShortcutString(config.input.save)))
@@ -787,8 +829,16 @@ namespace MikuMikuWorld
 		int laneExtension = context.score.metadata.laneExtension;
 		context.score.metadata = context.workingData.toScoreMetadata();
 		context.score.metadata.laneExtension = laneExtension;
-		serializeScore(context.score, autoSavePath + "\\mmw_auto_save_" +
-		                                  Utilities::getCurrentDateTime() + CC_MMWS_EXTENSION);
+		try
+		{
+			serializeScore(context.score, autoSavePath + "\\mmw_auto_save_" +
+			                                  Utilities::getCurrentDateTime() + CC_MMWS_EXTENSION);
+		}
+		catch (const std::exception&)
+		{
+			// Try again at the next interval, the previous auto saves are left untouched
+			return;
+		}
 
 		// get mmws files
 		int mmwsCount = 0;
@@ -1,5 +1,7 @@
 #include "ScoreEditorWindows.h"
 #include <future>
+#include <optional>
+#include <unordered_map>
 
 namespace MikuMikuWorld
 {
@@ -20,6 +22,7 @@ namespace MikuMikuWorld
 		WaypointsWindow waypointsWindow{};
 		SettingsWindow settingsWindow{};
 		RecentFileNotFoundDialog recentFileNotFoundDialog{};
+		std::unordered_map<std::string, std::optional<ScoreFileInfo>> recentFileInfos;
 		AboutDialog aboutDialog{};
 
 		Stopwatch autoSaveTimer;
@@ -28,6 +31,8 @@ namespace MikuMikuWorld
 
 		bool save(std::string filename);
 		size_t updateRecentFilesList(const std::string& entry);
+		const ScoreFileInfo* getRecentFileInfo(const std::string& filename);
+		void drawScoreFileInfoTooltip(const ScoreFileInfo& info);
 
 	  public:
 		ScoreEditor();
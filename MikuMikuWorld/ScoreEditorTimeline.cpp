@@ -8,6 +8,7 @@
 #include "UI.h"
 #include "Utilities.h"
 #include <algorithm>
+#include <cfloat>
 #include <string>
 
 namespace MikuMikuWorld
@@ -63,10 +64,26 @@ namespace MikuMikuWorld
 		return laneOffset + (lane * laneWidth);
 	}
 
+	bool ScoreEditorTimeline::isTickVisible(int tick) const
+	{
+		const float y = getNoteYPosFromTick(tick);
+		return !cullOffscreen || (y >= 0 && y <= size.y + position.y + 100);
+	}
+
 	bool ScoreEditorTimeline::isNoteVisible(const Note& note, int offsetTicks) const
 	{
-		const float y = getNoteYPosFromTick(note.tick + offsetTicks);
-		return y >= 0 && y <= size.y + position.y + 100;
+		return isTickVisible(note.tick + offsetTicks);
+	}
+
+	int ScoreEditorTimeline::getVisibleStartTick() const
+	{
+		// Tick bounds of isNoteVisible padded to account for rounding
+		return positionToTick(visualOffset - size.y - position.y) - 1;
+	}
+
+	int ScoreEditorTimeline::getVisibleEndTick() const
+	{
+		return positionToTick(visualOffset + 100) + 1;
 	}
 
 	void ScoreEditorTimeline::setZoom(float value)
@@ -446,25 +463,26 @@ namespace MikuMikuWorld
 			}
 
 			float yThreshold = (notesHeight * 0.5f) + 2.0f;
-			for (const auto& [id, note] : context.score.notes)
-			{
-				if (note.layer != context.selectedLayer && !context.showAllLayers)
-					continue;
-				float x1 = laneToPosition(note.lane);
-				float x2 = laneToPosition(note.lane + note.width);
-				float y = -tickToPosition(note.tick);
-
-				if (right > x1 && left < x2 &&
-				    isWithinRange(y, top - yThreshold, bottom + yThreshold))
-				{
-					if (io.KeyAlt)
-						context.selectedNotes.erase(id);
-					else
-						context.selectedNotes.insert(id);
-				}
+			const float tickHeight = unitHeight * zoom;
+			std::vector<int> hits;
+			context.score.getNoteColumns().queryRect(
+			    -(bottom + yThreshold) / tickHeight, -(top - yThreshold) / tickHeight,
+			    (left - laneOffset) / laneWidth, (right - laneOffset) / laneWidth,
+			    context.showAllLayers ? -1 : context.selectedLayer, hits);
+			for (int id : hits)
+			{
+				if (io.KeyAlt)
+					context.selectedNotes.erase(id);
+				else
+					context.selectedNotes.insert(id);
 			}
-			for (const auto& [id, hsc] : context.score.hiSpeedChanges)
+
+			const int startTick = positionToTick(-(bottom + yThreshold)) - 1;
+			const int endTick = positionToTick(-(top - yThreshold)) + 1;
+			for (int id : context.score.hiSpeedChangesInTickRange(
+			         startTick, endTick, context.showAllLayers ? -1 : context.selectedLayer))
 			{
+				const HiSpeedChange& hsc = context.score.hiSpeedChanges.at(id);
 				float lx =
 				    laneToPosition(MAX_LANE + context.score.metadata.laneExtension + 1) + 123;
 				float rx =
@@ -520,10 +538,11 @@ namespace MikuMikuWorld
 		// Draw measures
 		int firstTick = std::max(0, positionToTick(visualOffset - size.y));
 		int lastTick = positionToTick(visualOffset);
-		int measure = accumulateMeasures(firstTick, TICKS_PER_BEAT, context.score.timeSignatures);
-		firstTick = measureToTicks(measure, TICKS_PER_BEAT, context.score.timeSignatures);
+		const MeasureTable& measures = context.score.getMeasureTable();
+		int measure = measures.accumulateMeasures(firstTick);
+		firstTick = measures.measureToTicks(measure);
 
-		int tsIndex = findTimeSignature(measure, context.score.timeSignatures);
+		int tsIndex = measures.findTimeSignature(measure);
 		int ticksPerMeasure =
 		    beatsPerMeasure(context.score.timeSignatures[tsIndex]) * TICKS_PER_BEAT;
 		int beatTicks = ticksPerMeasure / context.score.timeSignatures[tsIndex].numerator;
@@ -535,8 +554,7 @@ namespace MikuMikuWorld
 		     tick += subdivision)
 		{
 			const int y = position.y - tickToPosition(tick) + visualOffset;
-			int currentMeasure =
-			    accumulateMeasures(tick, TICKS_PER_BEAT, context.score.timeSignatures);
+			int currentMeasure = measures.accumulateMeasures(tick);
 
 			// Time signature changes on current measure
 			if (context.score.timeSignatures.find(currentMeasure) !=
@@ -549,13 +567,12 @@ namespace MikuMikuWorld
 				beatTicks = ticksPerMeasure / context.score.timeSignatures[tsIndex].numerator;
 
 				// snap to sub-division again on time signature change
-				tick = measureToTicks(currentMeasure, TICKS_PER_BEAT, context.score.timeSignatures);
+				tick = measures.measureToTicks(currentMeasure);
 				tick -= tick % subdivision;
 			}
 
 			// determine whether the tick is a beat relative to its measure's tick
-			int measureTicks =
-			    measureToTicks(currentMeasure, TICKS_PER_BEAT, context.score.timeSignatures);
+			int measureTicks = measures.measureToTicks(currentMeasure);
 
 			ImU32 color;
 			ImU32 exColor;
@@ -582,7 +599,7 @@ namespace MikuMikuWorld
 			drawList->AddLine(ImVec2(x2, y), ImVec2(exX2, y), exColor, thickness);
 		}
 
-		tsIndex = findTimeSignature(measure, context.score.timeSignatures);
+		tsIndex = measures.findTimeSignature(measure);
 		ticksPerMeasure = beatsPerMeasure(context.score.timeSignatures[tsIndex]) * TICKS_PER_BEAT;
 
 		// Overdraw one measure to make sure the measure string is always visible
@@ -639,8 +656,10 @@ namespace MikuMikuWorld
 		contextMenu(context);
 
 		// Update hi-speed changes
-		for (auto& [id, hiSpeed] : context.score.hiSpeedChanges)
+		for (int id : context.score.hiSpeedChangesInTickRange(getVisibleStartTick(),
+		                                                      getVisibleEndTick(), -1))
 		{
+			const HiSpeedChange& hiSpeed = context.score.hiSpeedChanges.at(id);
 			if (hiSpeedControl(context, hiSpeed))
 			{
 				eventEdit.editIndex = id;
@@ -653,10 +672,8 @@ namespace MikuMikuWorld
 		// Update time signature changes
 		for (auto& [measure, ts] : context.score.timeSignatures)
 		{
-			if (timeSignatureControl(
-			        context.score, ts.numerator, ts.denominator,
-			        measureToTicks(ts.measure, TICKS_PER_BEAT, context.score.timeSignatures),
-			        !playing))
+			if (timeSignatureControl(context.score, ts.numerator, ts.denominator,
+			                         measures.measureToTicks(ts.measure), !playing))
 			{
 				eventEdit.editIndex = measure;
 				eventEdit.editTimeSignatureNumerator = ts.numerator;
@@ -695,10 +712,9 @@ namespace MikuMikuWorld
 		// Update song boundaries
 		if (context.audio.isMusicInitialized())
 		{
-			int startTick = accumulateTicks(context.workingData.musicOffset / 1000, TICKS_PER_BEAT,
-			                                context.score.tempoChanges);
-			int endTick = accumulateTicks(context.audio.getMusicEndTime(), TICKS_PER_BEAT,
-			                              context.score.tempoChanges);
+			const TempoMap& tempoMap = context.score.getTempoMap();
+			int startTick = tempoMap.secondsToTicks(context.workingData.musicOffset / 1000);
+			int endTick = tempoMap.secondsToTicks(context.audio.getMusicEndTime());
 
 			float x = getTimelineEndX(context.score);
 			float y1 = position.y - tickToPosition(startTick) + visualOffset;
@@ -728,10 +744,10 @@ namespace MikuMikuWorld
 		}
 
 		// Selection boxes
-		for (int id : context.selectedNotes)
+		for (int id : context.score.notesInTickRange(getVisibleStartTick(), getVisibleEndTick()))
 		{
 			const Note& note = context.score.notes.at(id);
-			if (!isNoteVisible(note, 0))
+			if (!context.isNoteSelected(note) || !isNoteVisible(note, 0))
 				continue;
 
 			float x = position.x;
@@ -815,8 +831,7 @@ namespace MikuMikuWorld
 		if (activated)
 		{
 			gotoMeasure = std::max(gotoMeasure, 0);
-			scrollTimeline(
-			    context, measureToTicks(gotoMeasure, TICKS_PER_BEAT, context.score.timeSignatures));
+			scrollTimeline(context, context.score.getMeasureTable().measureToTicks(gotoMeasure));
 		}
 
 		ImGui::SameLine();
@@ -840,14 +855,13 @@ namespace MikuMikuWorld
 		ImGui::SeparatorEx(ImGuiSeparatorFlags_Vertical);
 		ImGui::SameLine();
 
-		int currentMeasure =
-		    accumulateMeasures(context.currentTick, TICKS_PER_BEAT, context.score.timeSignatures);
+		// The event editor may have changed time signatures since the measures were drawn
+		const MeasureTable& currentMeasures = context.score.getMeasureTable();
+		int currentMeasure = currentMeasures.accumulateMeasures(context.currentTick);
 		const TimeSignature& ts =
-		    context.score
-		        .timeSignatures[findTimeSignature(currentMeasure, context.score.timeSignatures)];
+		    context.score.timeSignatures[currentMeasures.findTimeSignature(currentMeasure)];
 		const Tempo& tempo = getTempoAt(context.currentTick, context.score.tempoChanges);
-		int hiSpeed = findHighSpeedChange(context.currentTick, context.score.hiSpeedChanges,
-		                                  context.selectedLayer);
+		int hiSpeed = context.score.findHiSpeedChange(context.currentTick, context.selectedLayer);
 		float speed = (hiSpeed == -1 ? 1.0f : context.score.hiSpeedChanges[hiSpeed].speed);
 
 		std::string rhythmString = IO::formatString(
@@ -873,7 +887,7 @@ namespace MikuMikuWorld
 		if (playing)
 		{
 			time += ImGui::GetIO().DeltaTime * playbackSpeed;
-			context.currentTick = accumulateTicks(time, TICKS_PER_BEAT, context.score.tempoChanges);
+			context.currentTick = context.score.getTempoMap().secondsToTicks(time);
 
 			float cursorY = tickToPosition(context.currentTick);
 			if (config.followCursorInPlayback)
@@ -889,8 +903,7 @@ namespace MikuMikuWorld
 		}
 		else
 		{
-			time =
-			    accumulateDuration(context.currentTick, TICKS_PER_BEAT, context.score.tempoChanges);
+			time = context.score.getTempoMap().ticksToSeconds(context.currentTick);
 		}
 	}
 
@@ -910,9 +923,13 @@ namespace MikuMikuWorld
 		framebuffer->clear();
 		renderer->beginBatch();
 
+		const int visibleStartTick = getVisibleStartTick();
+		const int visibleEndTick = getVisibleEndTick();
+
 		minNoteYDistance = INT_MAX;
-		for (auto& [id, note] : context.score.notes)
+		for (int id : context.score.notesInTickRange(visibleStartTick, visibleEndTick))
 		{
+			Note& note = context.score.notes.at(id);
 			if (!isNoteVisible(note))
 				continue;
 			if (note.getType() == NoteType::Tap)
@@ -935,8 +952,9 @@ namespace MikuMikuWorld
 			}
 		}
 
-		for (auto& [id, hold] : context.score.holdNotes)
+		for (int id : context.score.holdsInTickRange(visibleStartTick, visibleEndTick))
 		{
+			const HoldNote& hold = context.score.holdNotes.at(id);
 			Note& start = context.score.notes.at(hold.start.ID);
 			Note& end = context.score.notes.at(hold.end);
 
@@ -954,8 +972,8 @@ namespace MikuMikuWorld
 					break;
 			}
 
-			drawHoldNote(context.score.notes, hold, renderer, noteTint,
-			             context.showAllLayers ? -1 : context.selectedLayer);
+			drawHoldNote(context.score.notes, hold, context.score.getHoldSegments(id), renderer,
+			             noteTint, context.showAllLayers ? -1 : context.selectedLayer);
 		}
 		skipUpdateAfterSortingSteps = false;
 
@@ -973,6 +991,10 @@ namespace MikuMikuWorld
 			else if (ImGui::IsMouseClicked(1))
 				context.cancelPaste();
 		}
+		else if (!pasting && !pastePreview.quads.empty())
+		{
+			pastePreview = {};
+		}
 
 		if (mouseInTimeline && !isHoldingNote && currentMode != TimelineMode::Select && !pasting &&
 		    !playing && !UI::isAnyPopupOpen())
@@ -1008,28 +1030,95 @@ namespace MikuMikuWorld
 		drawSteps.clear();
 	}
 
+	void ScoreEditorTimeline::buildPastePreview(const ScoreContext& context, Renderer* renderer)
+	{
+		const PasteData& pasteData = context.pasteData;
+		const int selectedLayer = context.showAllLayers ? -1 : context.selectedLayer;
+		const size_t firstQuad = renderer->getQueuedQuadCount();
+		const size_t firstStep = drawSteps.size();
+
+		cullOffscreen = false;
+		for (const auto& notes : { &pasteData.notes, &pasteData.damages })
+			for (const auto& [_, note] : *notes)
+			{
+				const bool activeLayer = selectedLayer == -1 || note.layer == selectedLayer;
+				if (note.getType() == NoteType::Tap)
+					drawNote(note, renderer, hoverTint, 0, 0, activeLayer);
+				else if (note.getType() == NoteType::Damage)
+					drawCcNote(note, renderer, hoverTint, 0, 0, activeLayer);
+			}
+
+		std::vector<HoldSegment> segments;
+		for (const auto& [_, hold] : pasteData.holds)
+		{
+			resolveHoldSegments(pasteData.notes, hold, segments);
+			drawHoldNote(pasteData.notes, hold, segments, renderer, hoverTint, -1);
+		}
+		cullOffscreen = true;
+
+		pastePreview.quads.clear();
+		for (Quad& quad : renderer->takeQuads(firstQuad))
+		{
+			float top = FLT_MAX;
+			float bottom = -FLT_MAX;
+			for (const Vertex& vertex : quad.vertices)
+			{
+				float y = DirectX::XMVectorGetY(
+				    DirectX::XMVector2Transform(vertex.position, quad.matrix));
+				top = std::min(top, y);
+				bottom = std::max(bottom, y);
+			}
+
+			pastePreview.quads.push_back({ quad, top, bottom });
+		}
+
+		pastePreview.steps.assign(drawSteps.begin() + firstStep, drawSteps.end());
+		drawSteps.erase(drawSteps.begin() + firstStep, drawSteps.end());
+
+		pastePreview.origin = { laneToPosition(0), getNoteYPosFromTick(0) };
+		pastePreview.pasteVersion = pasteData.version;
+		pastePreview.zoom = zoom;
+		pastePreview.laneWidth = laneWidth;
+		pastePreview.notesHeight = notesHeight;
+		pastePreview.selectedLayer = selectedLayer;
+		pastePreview.stepOutlines = drawHoldStepOutlines;
+	}
+
 	void ScoreEditorTimeline::previewPaste(ScoreContext& context, Renderer* renderer)
 	{
 		context.pasteData.offsetLane =
 		    std::clamp(hoverLane - context.pasteData.midLane, context.pasteData.minLaneOffset,
 		               context.pasteData.maxLaneOffset);
 
-		for (const auto notes : { context.pasteData.notes, context.pasteData.damages })
-			for (const auto& [_, note] : notes)
-				if (isNoteVisible(note, hoverTick))
-				{
-					if (note.getType() == NoteType::Tap)
-						drawNote(note, renderer, hoverTint, hoverTick, context.pasteData.offsetLane,
-						         context.showAllLayers || note.layer == context.selectedLayer);
-					else if (note.getType() == NoteType::Damage)
-						drawCcNote(note, renderer, hoverTint, hoverTick,
-						           context.pasteData.offsetLane,
-						           context.showAllLayers || note.layer == context.selectedLayer);
-				}
+		if (pastePreview.pasteVersion != context.pasteData.version ||
+		    pastePreview.zoom != zoom || pastePreview.laneWidth != laneWidth ||
+		    pastePreview.notesHeight != notesHeight ||
+		    pastePreview.selectedLayer != (context.showAllLayers ? -1 : context.selectedLayer) ||
+		    pastePreview.stepOutlines != drawHoldStepOutlines)
+			buildPastePreview(context, renderer);
+
+		// Positions are linear in ticks and lanes so the offset is a translation
+		const float offsetX = laneToPosition(context.pasteData.offsetLane) - pastePreview.origin.x;
+		const float offsetY = getNoteYPosFromTick(hoverTick) - pastePreview.origin.y;
+		const DirectX::XMVECTOR translation = DirectX::XMVectorSet(offsetX, offsetY, 0.0f, 0.0f);
+		for (const PreviewQuad& previewQuad : pastePreview.quads)
+		{
+			if (previewQuad.bottom + offsetY < 0 ||
+			    previewQuad.top + offsetY > size.y + position.y + 100)
+				continue;
 
-		for (const auto& [_, hold] : context.pasteData.holds)
-			drawHoldNote(context.pasteData.notes, hold, renderer, hoverTint, -1, hoverTick,
-			             context.pasteData.offsetLane);
+			Quad quad = previewQuad.quad;
+			quad.matrix.r[3] = DirectX::XMVectorAdd(quad.matrix.r[3], translation);
+			renderer->pushQuad(quad);
+		}
+
+		for (StepDrawData step : pastePreview.steps)
+		{
+			step.tick += hoverTick;
+			step.lane += context.pasteData.offsetLane;
+			if (isTickVisible(step.tick))
+				drawSteps.push_back(step);
+		}
 
 		for (const auto& [_, hsc] : context.pasteData.hiSpeedChanges)
 			hiSpeedControl(context, hsc.tick + hoverTick, hsc.speed, -1);
@@ -1079,35 +1168,32 @@ namespace MikuMikuWorld
 				if (tempo.tick == hoverTick)
 					return;
 
-			Score prev = context.score;
 			context.score.tempoChanges.push_back({ hoverTick, edit.bpm });
 			std::sort(context.score.tempoChanges.begin(), context.score.tempoChanges.end(),
 			          [](const auto& a, const auto& b) { return a.tick < b.tick; });
-			context.pushHistory("Insert BPM change", prev, context.score);
+			context.score.invalidateTempoMap();
+			context.pushHistory("Insert BPM change");
 		}
 		else if (currentMode == TimelineMode::InsertTimeSign)
 		{
-			int measure =
-			    accumulateMeasures(hoverTick, TICKS_PER_BEAT, context.score.timeSignatures);
+			int measure = context.score.getMeasureTable().accumulateMeasures(hoverTick);
 			if (context.score.timeSignatures.find(measure) != context.score.timeSignatures.end())
 				return;
 
-			Score prev = context.score;
 			context.score.timeSignatures[measure] = { measure, edit.timeSignatureNumerator,
 				                                      edit.timeSignatureDenominator };
-			context.pushHistory("Insert time signature", prev, context.score);
+			context.score.invalidateMeasureTable();
+			context.pushHistory("Insert time signature");
 		}
 		else if (currentMode == TimelineMode::InsertHiSpeed)
 		{
-			for (const auto& [_, hs] : context.score.hiSpeedChanges)
-				if (hs.tick == hoverTick && hs.layer == context.selectedLayer)
-					return;
+			if (!context.score.hiSpeedChangesInTickRange(hoverTick, hoverTick, context.selectedLayer)
+			         .empty())
+				return;
 
-			Score prev = context.score;
-			int id = nextHiSpeedID++;
-			context.score.hiSpeedChanges[id] = { id, hoverTick, edit.hiSpeed,
-				                                 context.selectedLayer };
-			context.pushHistory("Insert hi-speed changes", prev, context.score);
+			int id = context.score.allocateHiSpeedID();
+			context.score.addHiSpeedChange({ id, hoverTick, edit.hiSpeed, context.selectedLayer });
+			context.pushHistory("Insert hi-speed changes");
 		}
 	}
 
@@ -1267,8 +1353,9 @@ namespace MikuMikuWorld
 		float xt = laneToPosition(lane);
 		float yt = getNoteYPosFromTick(tick);
 
-		for (const auto& [id, hold] : context.score.holdNotes)
+		for (int id : context.score.holdsInTickRange(tick, tick))
 		{
+			const HoldNote& hold = context.score.holdNotes.at(id);
 			const Note& start = context.score.notes.at(hold.start.ID);
 			const Note& end = context.score.notes.at(hold.end);
 
@@ -1276,53 +1363,12 @@ namespace MikuMikuWorld
 			if (start.tick > tick || end.tick < tick)
 				continue;
 
-			// Do not take skip steps into account
-			int s1{ -1 }, s2{ -1 };
-			while (++s2 < hold.steps.size())
-			{
-				if (hold.steps[s2].type != HoldStepType::Skip)
-					break;
-			}
-
-			if (isArrayIndexInBounds(s2, hold.steps))
-			{
-				// Getting here means we found a non-skip step
-				if ((context.showAllLayers || start.layer == context.selectedLayer ||
-				     context.score.notes.at(hold.steps[s2].ID).layer == context.selectedLayer) &&
-				    isMouseInHoldPath(start, context.score.notes.at(hold.steps[s2].ID),
-				                      hold.start.ease, xt, yt))
-					return id;
-
-				s1 = s2;
-				while (++s2 < hold.steps.size())
-				{
-					if (hold.steps[s2].type != HoldStepType::Skip)
-					{
-						const Note& m1 = context.score.notes.at(hold.steps[s1].ID);
-						const Note& m2 = context.score.notes.at(hold.steps[s2].ID);
-						if ((context.showAllLayers || m1.layer == context.selectedLayer ||
-						     m2.layer == context.selectedLayer) &&
-						    isMouseInHoldPath(m1, m2, hold.steps[s1].ease, xt, yt))
-							return id;
-
-						s1 = s2;
-					}
-				}
-
-				int nextId = hold.steps[s1].ID;
-				if ((context.showAllLayers || start.layer == context.selectedLayer ||
-				     context.score.notes.at(nextId).layer == context.selectedLayer) &&
-				    isMouseInHoldPath(context.score.notes.at(nextId), end, hold.steps[s1].ease, xt,
-				                      yt))
-					return id;
-			}
-			else
+			// Segments do not include skip steps
+			for (const HoldSegment& segment : context.score.getHoldSegments(id))
 			{
-				// Hold consists of only skip steps or no steps at all
-
-				if ((context.showAllLayers || start.layer == context.selectedLayer ||
-				     end.layer == context.selectedLayer) &&
-				    isMouseInHoldPath(start, end, hold.start.ease, xt, yt))
+				if ((context.showAllLayers || segment.from.layer == context.selectedLayer ||
+				     segment.to.layer == context.selectedLayer) &&
+				    isMouseInHoldPath(segment, xt, yt))
 					return id;
 			}
 		}
@@ -1353,7 +1399,6 @@ namespace MikuMikuWorld
 		// Note clicked
 		if (ImGui::IsItemActivated())
 		{
-			prevUpdateScore = context.score;
 			ctrlMousePos = mousePos;
 			holdLane = hoverLane;
 			holdTick = hoverTick;
@@ -1371,12 +1416,13 @@ namespace MikuMikuWorld
 		if (ImGui::IsItemDeactivated())
 		{
 			bool noChange = false;
-			auto it = context.score.notes.find(holdingNote);
-			if (it != context.score.notes.end())
-				noChange = noteTransformOrigin.isSame(it->second);
+			// The held note may have been removed while dragging
+			const Note* heldNote = context.score.notes.get(holdingNote);
+			if (heldNote)
+				noChange = noteTransformOrigin.isSame(*heldNote);
 
 			isHoldingNote = false;
-			holdingNote = 0;
+			holdingNote = {};
 
 			if (!noChange)
 			{
@@ -1425,7 +1471,7 @@ namespace MikuMikuWorld
 					skipUpdateAfterSortingSteps = true;
 				}
 
-				context.pushHistory("Update notes", prevUpdateScore, context.score);
+				context.pushHistory("Update notes");
 			}
 		}
 
@@ -1475,7 +1521,7 @@ namespace MikuMikuWorld
 
 					if (context.isNoteSelected(note))
 					{
-						holdingNote = note.ID;
+						holdingNote = context.score.notes.getHandle(note.ID);
 						noteTransformOrigin = NoteTransform::fromNote(note);
 					}
 				}
@@ -1511,6 +1557,7 @@ namespace MikuMikuWorld
 						Note& n = context.score.notes.at(id);
 						n.width = std::clamp(n.width - diff, MIN_NOTE_WIDTH, maxNoteWidth);
 						n.lane = std::clamp(n.lane + diff, minLane, maxLane - n.width + 1);
+						context.score.invalidateHoldGeometry(n);
 					}
 				}
 			}
@@ -1546,6 +1593,7 @@ namespace MikuMikuWorld
 					{
 						Note& n = context.score.notes.at(id);
 						n.lane = std::clamp(n.lane + diff, minLane, maxLane - n.width + 1);
+						context.score.invalidateHoldGeometry(n);
 					}
 				}
 			}
@@ -1566,7 +1614,7 @@ namespace MikuMikuWorld
 					for (int id : context.selectedNotes)
 					{
 						Note& n = context.score.notes.at(id);
-						n.tick = std::max(n.tick + diff, 0);
+						context.score.moveNoteTick(n, std::max(n.tick + diff, 0));
 					}
 				}
 			}
@@ -1639,6 +1687,7 @@ namespace MikuMikuWorld
 					{
 						Note& n = context.score.notes.at(id);
 						n.width = std::clamp(n.width + diff, MIN_NOTE_WIDTH, maxNoteWidth - n.lane);
+						context.score.invalidateHoldGeometry(n);
 					}
 				}
 			}
@@ -1648,11 +1697,22 @@ namespace MikuMikuWorld
 	}
 
 	void ScoreEditorTimeline::drawHoldCurve(const Note& n1, const Note& n2, EaseType ease,
-	                                        bool isGuide, Renderer* renderer, const Color& tint_,
+	                                        bool isGuide, Renderer* renderer, const Color& tint,
 	                                        const int offsetTick, const int offsetLane,
 	                                        const float startAlpha, const float endAlpha,
 	                                        const GuideColor guideColor, const int selectedLayer)
 	{
+		drawHoldSegment({ toHoldPoint(n1), toHoldPoint(n2), ease, startAlpha, endAlpha }, isGuide,
+		                renderer, tint, offsetTick, offsetLane, guideColor, selectedLayer);
+	}
+
+	void ScoreEditorTimeline::drawHoldSegment(const HoldSegment& segment, bool isGuide,
+	                                          Renderer* renderer, const Color& tint_,
+	                                          const int offsetTick, const int offsetLane,
+	                                          const GuideColor guideColor, const int selectedLayer)
+	{
+		const HoldPoint& n1 = segment.from;
+		const HoldPoint& n2 = segment.to;
 		int texIndex{ noteTextures.holdPath };
 		ZIndex zIndex{ ZIndex::HoldLine };
 		if (isGuide)
@@ -1683,7 +1743,7 @@ namespace MikuMikuWorld
 		int left = spr.getX() + holdCutoffX;
 		int right = spr.getX() + spr.getWidth() - holdCutoffX;
 
-		auto easeFunc = getEaseFunction(ease);
+		auto easeFunc = getEaseFunction(segment.ease);
 		float steps = std::max(5.0f, std::ceilf(abs((endY - startY)) / 10));
 		for (int y = 0; y < steps; ++y)
 		{
@@ -1702,11 +1762,11 @@ namespace MikuMikuWorld
 			            ? (int)ZIndex::zCount
 			            : 0;
 
-			if (y2 <= 0)
+			if (cullOffscreen && y2 <= 0)
 				continue;
 
 			// rest of hold no longer visible
-			if (y1 > size.y + size.y + position.y + 100)
+			if (cullOffscreen && y1 > size.y + size.y + position.y + 100)
 				break;
 
 			Color localTint =
@@ -1715,7 +1775,7 @@ namespace MikuMikuWorld
 			        : Color::lerp(n1.layer == selectedLayer ? noteTint : inactiveTint,
 			                      n2.layer == selectedLayer ? noteTint : inactiveTint, percent1);
 
-			localTint.a = tint.a * lerp(0.7, 1, lerp(startAlpha, endAlpha, percent1));
+			localTint.a = tint.a * lerp(0.7, 1, lerp(segment.fromAlpha, segment.toAlpha, percent1));
 
 			Vector2 p1{ xl1, y1 };
 			Vector2 p2{ xl1 + holdSliceSize, y1 };
@@ -1756,85 +1816,25 @@ namespace MikuMikuWorld
 		}
 	}
 
-	void ScoreEditorTimeline::drawHoldNote(const std::unordered_map<int, Note>& notes,
-	                                       const HoldNote& note, Renderer* renderer,
-	                                       const Color& tint_, const int selectedLayer,
-	                                       const int offsetTicks, const int offsetLane)
+	void ScoreEditorTimeline::drawHoldNote(const SlotMap<Note>& notes, const HoldNote& note,
+	                                       const std::vector<HoldSegment>& segments,
+	                                       Renderer* renderer, const Color& tint_,
+	                                       const int selectedLayer, const int offsetTicks,
+	                                       const int offsetLane)
 	{
 		const Note& start = notes.at(note.start.ID);
 		const Note& end = notes.at(note.end);
-		const int length = abs(end.tick - start.tick);
 		auto tint = tint_;
+		for (const HoldSegment& segment : segments)
+			drawHoldSegment(segment, note.isGuide(), renderer, tint, offsetTicks, offsetLane,
+			                note.guideColor, selectedLayer);
+
 		if (note.steps.size())
 		{
 			static constexpr auto isSkipStep = [](const HoldStep& step)
 			{ return step.type == HoldStepType::Skip; };
 			int s1 = -1;
-			int s2 = -1;
-
-			if (length > 0)
-			{
-				for (int i = 0; i < note.steps.size(); ++i)
-				{
-					if (isSkipStep(note.steps[i]))
-						continue;
-
-					s2 = i;
-					const Note& n1 = s1 == -1 ? start : notes.at(note.steps[s1].ID);
-					const Note& n2 = s2 == -1 ? end : notes.at(note.steps[s2].ID);
-					const EaseType ease = s1 == -1 ? note.start.ease : note.steps[s1].ease;
-					const float p1 = (n1.tick - start.tick) / (float)length;
-					const float p2 = (n2.tick - start.tick) / (float)length;
-					float a1, a2;
-					if (!note.isGuide() || note.fadeType == FadeType::None)
-					{
-						a1 = 1;
-						a2 = 1;
-					}
-					else if (note.fadeType == FadeType::In)
-					{
-						a1 = p1;
-						a2 = p2;
-					}
-					else
-					{
-						a1 = 1 - p1;
-						a2 = 1 - p2;
-					}
-					drawHoldCurve(n1, n2, ease, note.isGuide(), renderer, tint, offsetTicks,
-					              offsetLane, a1, a2, note.guideColor, selectedLayer);
-
-					s1 = s2;
-				}
-
-				const float p1 =
-				    s1 == -1 ? 0 : (notes.at(note.steps[s1].ID).tick - start.tick) / (float)length;
-				const float p2 = 1;
-				float a1, a2;
-				if (!note.isGuide() || note.fadeType == FadeType::None)
-				{
-					a1 = 1;
-					a2 = 1;
-				}
-				else if (note.fadeType == FadeType::In)
-				{
-					a1 = p1;
-					a2 = p2;
-				}
-				else
-				{
-					a1 = 1 - p1;
-					a2 = 1 - p2;
-				}
-
-				const Note& n1 = s1 == -1 ? start : notes.at(note.steps[s1].ID);
-				const EaseType ease = s1 == -1 ? note.start.ease : note.steps[s1].ease;
-				drawHoldCurve(n1, end, ease, note.isGuide(), renderer, tint, offsetTicks,
-				              offsetLane, a1, a2, note.guideColor, selectedLayer);
-			}
-
-			s1 = -1;
-			s2 = 1;
+			int s2 = 1;
 
 			if (noteTextures.notes == -1)
 				return;
@@ -1914,27 +1914,6 @@ namespace MikuMikuWorld
 					s1 = i;
 			}
 		}
-		else
-		{
-			float a1, a2;
-			if (!note.isGuide() || note.fadeType == FadeType::None)
-			{
-				a1 = 1;
-				a2 = 1;
-			}
-			else if (note.fadeType == FadeType::In)
-			{
-				a1 = 0;
-				a2 = 1;
-			}
-			else
-			{
-				a1 = 1;
-				a2 = 0;
-			}
-			drawHoldCurve(start, end, note.start.ease, note.isGuide(), renderer, tint, offsetTicks,
-			              offsetLane, a1, a2, note.guideColor, selectedLayer);
-		}
 
 		auto inactiveTint = tint * otherLayerTint;
 
@@ -2343,10 +2322,10 @@ namespace MikuMikuWorld
 				UI::addFloatProperty(getString("bpm"), eventEdit.editBpm, "%g");
 				if (ImGui::IsItemDeactivatedAfterEdit())
 				{
-					Score prev = context.score;
 					tempo.bpm = std::clamp(eventEdit.editBpm, MIN_BPM, MAX_BPM);
+					context.score.invalidateTempoMap();
 
-					context.pushHistory("Change tempo", prev, context.score);
+					context.pushHistory("Change tempo");
 				}
 				UI::endPropertyColumns();
 
@@ -2357,10 +2336,10 @@ namespace MikuMikuWorld
 					if (ImGui::Button(getString("remove"), ImVec2(-1, UI::btnSmall.y + 2)))
 					{
 						ImGui::CloseCurrentPopup();
-						Score prev = context.score;
 						context.score.tempoChanges.erase(context.score.tempoChanges.begin() +
 						                                 eventEdit.editIndex);
-						context.pushHistory("Remove tempo change", prev, context.score);
+						context.score.invalidateTempoMap();
+						context.pushHistory("Remove tempo change");
 					}
 				}
 			}
@@ -2378,14 +2357,14 @@ namespace MikuMikuWorld
 				if (UI::timeSignatureSelect(eventEdit.editTimeSignatureNumerator,
 				                            eventEdit.editTimeSignatureDenominator))
 				{
-					Score prev = context.score;
 					TimeSignature& ts = context.score.timeSignatures[eventEdit.editIndex];
 					ts.numerator = std::clamp(abs(eventEdit.editTimeSignatureNumerator),
 					                          MIN_TIME_SIGNATURE, MAX_TIME_SIGNATURE_NUMERATOR);
 					ts.denominator = std::clamp(abs(eventEdit.editTimeSignatureDenominator),
 					                            MIN_TIME_SIGNATURE, MAX_TIME_SIGNATURE_DENOMINATOR);
+					context.score.invalidateMeasureTable();
 
-					context.pushHistory("Change time signature", prev, context.score);
+					context.pushHistory("Change time signature");
 				}
 				UI::endPropertyColumns();
 
@@ -2396,9 +2375,9 @@ namespace MikuMikuWorld
 					if (ImGui::Button(getString("remove"), ImVec2(-1, UI::btnSmall.y + 2)))
 					{
 						ImGui::CloseCurrentPopup();
-						Score prev = context.score;
 						context.score.timeSignatures.erase(eventEdit.editIndex);
-						context.pushHistory("Remove time signature", prev, context.score);
+						context.score.invalidateMeasureTable();
+						context.pushHistory("Remove time signature");
 					}
 				}
 			}
@@ -2417,10 +2396,9 @@ namespace MikuMikuWorld
 				HiSpeedChange& hiSpeed = context.score.hiSpeedChanges[eventEdit.editIndex];
 				if (ImGui::IsItemDeactivatedAfterEdit())
 				{
-					Score prev = context.score;
 					hiSpeed.speed = eventEdit.editHiSpeed;
 
-					context.pushHistory("Change hi-speed", prev, context.score);
+					context.pushHistory("Change hi-speed");
 				}
 				UI::endPropertyColumns();
 
@@ -2428,9 +2406,8 @@ namespace MikuMikuWorld
 				if (ImGui::Button(getString("remove"), ImVec2(-1, UI::btnSmall.y + 2)))
 				{
 					ImGui::CloseCurrentPopup();
-					Score prev = context.score;
-					context.score.hiSpeedChanges.erase(eventEdit.editIndex);
-					context.pushHistory("Remove hi-speed change", prev, context.score);
+					context.score.eraseHiSpeedChange(eventEdit.editIndex);
+					context.pushHistory("Remove hi-speed change");
 				}
 			}
 			else if (eventEdit.type == EventType::Waypoint)
@@ -2447,10 +2424,9 @@ namespace MikuMikuWorld
 				Waypoint& waypoint = context.score.waypoints[eventEdit.editIndex];
 				if (ImGui::IsItemDeactivatedAfterEdit())
 				{
-					Score prev = context.score;
 					waypoint.name = eventEdit.editName;
 
-					context.pushHistory("Change waypoint", prev, context.score);
+					context.pushHistory("Change waypoint");
 				}
 				UI::endPropertyColumns();
 
@@ -2458,19 +2434,19 @@ namespace MikuMikuWorld
 				if (ImGui::Button(getString("remove"), ImVec2(-1, UI::btnSmall.y + 2)))
 				{
 					ImGui::CloseCurrentPopup();
-					Score prev = context.score;
 					context.score.waypoints.erase(context.score.waypoints.begin() +
 					                              eventEdit.editIndex);
-					context.pushHistory("Remove waypint", prev, context.score);
+					context.pushHistory("Remove waypint");
 				}
 			}
 			ImGui::EndPopup();
 		}
 	}
 
-	bool ScoreEditorTimeline::isMouseInHoldPath(const Note& n1, const Note& n2, EaseType ease,
-	                                            float x, float y)
+	bool ScoreEditorTimeline::isMouseInHoldPath(const HoldSegment& segment, float x, float y)
 	{
+		const HoldPoint& n1 = segment.from;
+		const HoldPoint& n2 = segment.to;
 		float xStart1 = laneToPosition(n1.lane);
 		float xStart2 = laneToPosition(n1.lane + n1.width);
 		float xEnd1 = laneToPosition(n2.lane);
@@ -2481,7 +2457,7 @@ namespace MikuMikuWorld
 		if (!isWithinRange(y, y1, y2))
 			return false;
 
-		auto easeFunc = getEaseFunction(ease);
+		auto easeFunc = getEaseFunction(segment.ease);
 		float percent = (y - y1) / (y2 - y1);
 		float x1 = easeFunc(xStart1, xEnd1, percent);
 		float x2 = easeFunc(xStart2, xEnd2, percent);
@@ -2518,26 +2494,22 @@ namespace MikuMikuWorld
 
 	void ScoreEditorTimeline::insertNote(ScoreContext& context, EditArgs& edit)
 	{
-		Score prev = context.score;
-
 		Note newNote = inputNotes.tap;
-		newNote.ID = nextID++;
+		newNote.ID = context.score.allocateNoteID();
 		newNote.layer = context.selectedLayer;
 
 		context.score.notes[newNote.ID] = newNote;
-		context.pushHistory("Insert note", prev, context.score);
+		context.pushHistory("Insert note");
 	}
 
 	void ScoreEditorTimeline::insertHold(ScoreContext& context, EditArgs& edit)
 	{
-		Score prev = context.score;
-
 		Note holdStart = inputNotes.holdStart;
-		holdStart.ID = nextID++;
+		holdStart.ID = context.score.allocateNoteID();
 		holdStart.layer = context.selectedLayer;
 
 		Note holdEnd = inputNotes.holdEnd;
-		holdEnd.ID = nextID++;
+		holdEnd.ID = context.score.allocateNoteID();
 		holdEnd.parentID = holdStart.ID;
 		holdEnd.layer = context.selectedLayer;
 
@@ -2567,7 +2539,7 @@ namespace MikuMikuWorld
 			                                      holdType,
 			                                      edit.fadeType,
 			                                      edit.colorType };
-		context.pushHistory("Insert hold", prev, context.score);
+		context.pushHistory("Insert hold");
 	}
 
 	void ScoreEditorTimeline::insertHoldStep(ScoreContext& context, EditArgs& edit, int holdId)
@@ -2580,13 +2552,12 @@ namespace MikuMikuWorld
 		if (context.score.notes.find(holdId) == context.score.notes.end())
 			return;
 
-		Score prev = context.score;
 
 		HoldNote& hold = context.score.holdNotes[holdId];
 		Note holdStart = context.score.notes[holdId];
 
 		Note holdStep = inputNotes.holdStep;
-		holdStep.ID = nextID++;
+		holdStep.ID = context.score.allocateNoteID();
 		holdStep.critical = holdStart.critical;
 		holdStep.parentID = holdStart.ID;
 		holdStep.layer = context.selectedLayer;
@@ -2598,19 +2569,17 @@ namespace MikuMikuWorld
 
 		// sort steps in-case the step is inserted before/after existing steps
 		sortHoldSteps(context.score, hold);
-		context.pushHistory("Insert hold step", prev, context.score);
+		context.pushHistory("Insert hold step");
 	}
 
 	void ScoreEditorTimeline::insertDamage(ScoreContext& context, EditArgs& edit)
 	{
-		Score prev = context.score;
-
 		Note newNote = inputNotes.damage;
-		newNote.ID = nextID++;
+		newNote.ID = context.score.allocateNoteID();
 		newNote.layer = context.selectedLayer;
 
 		context.score.notes[newNote.ID] = newNote;
-		context.pushHistory("Insert damage", prev, context.score);
+		context.pushHistory("Insert damage");
 	}
 
 	void ScoreEditorTimeline::debug(ScoreContext& context)
@@ -2642,7 +2611,7 @@ namespace MikuMikuWorld
 		if (ImGui::CollapsingHeader("Hover Note", ImGuiTreeNodeFlags_DefaultOpen))
 		{
 			ImGui::Text("Hovering note ID: %d", hoveringNote);
-			ImGui::Text("Holding note ID: %d", holdingNote);
+			ImGui::Text("Holding note ID: %d", holdingNote.ID);
 
 			auto it = context.score.notes.find(hoveringNote);
 			if (it != context.score.notes.end())
@@ -2754,18 +2723,18 @@ namespace MikuMikuWorld
 		static auto holdNoteSEFunc = [&context, this](const Note& note, float startTime)
 		{
 			int endTick = context.score.notes.at(context.score.holdNotes.at(note.ID).end).tick;
-			float endTime = accumulateDuration(endTick, TICKS_PER_BEAT, context.score.tempoChanges);
+			float endTime = context.score.getTempoMap().ticksToSeconds(endTick);
 
 			float adjustedEndTime = endTime - playStartTime + audioOffsetCorrection;
 			context.audio.playSoundEffect(note.critical ? SE_CRITICAL_CONNECT : SE_CONNECT,
 			                              startTime, adjustedEndTime, time);
 		};
 
+		const TempoMap& tempoMap = context.score.getTempoMap();
 		playingNoteSounds.clear();
 		for (const auto& [id, note] : context.score.notes)
 		{
-			float noteTime =
-			    accumulateDuration(note.tick, TICKS_PER_BEAT, context.score.tempoChanges);
+			float noteTime = tempoMap.ticksToSeconds(note.tick);
 			float notePlayTime = noteTime - playStartTime;
 			float offsetNoteTime = noteTime - (audioLookAhead * playbackSpeed);
 
@@ -2788,8 +2757,7 @@ namespace MikuMikuWorld
 				{
 					int endTick =
 					    context.score.notes.at(context.score.holdNotes.at(note.ID).end).tick;
-					float endTime =
-					    accumulateDuration(endTick, TICKS_PER_BEAT, context.score.tempoChanges);
+					float endTime = tempoMap.ticksToSeconds(endTick);
 					if ((noteTime - time) <= audioLookAhead && endTime > time)
 						holdNoteSEFunc(note, std::max(0.0f, notePlayTime));
 				}
@@ -2812,6 +2780,7 @@ namespace MikuMikuWorld
 		const double musicOffsetInSeconds = context.workingData.musicOffset / 1000.0f;
 
 		const float timelineMidPosition = midpoint(getTimelineStartX(), getTimelineEndX());
+		const TempoMap& tempoMap = context.score.getTempoMap();
 
 		for (size_t index = 0; index < 2; index++)
 		{
@@ -2829,9 +2798,7 @@ namespace MikuMikuWorld
 				int tick = positionToTick(y);
 
 				// Small accuracy loss by converting to ticks but shouldn't be too noticeable
-				const double secondsAtPixel =
-				    accumulateDuration(tick, TICKS_PER_BEAT, context.score.tempoChanges) -
-				    musicOffsetInSeconds;
+				const double secondsAtPixel = tempoMap.ticksToSeconds(tick) - musicOffsetInSeconds;
 				const bool outOfBounds =
 				    secondsAtPixel < 0 || secondsAtPixel > waveform.durationInSeconds;
 
@@ -99,7 +99,7 @@ namespace MikuMikuWorld
 		int hoverLane{};
 		int hoverTick{};
 		int hoveringNote{};
-		int holdingNote{};
+		SlotMap<Note>::Handle holdingNote{};
 		int holdLane{};
 		int holdTick{};
 		int lastSelectedTick{};
@@ -133,8 +133,6 @@ namespace MikuMikuWorld
 		ImVec2 dragStart;
 		ImVec2 mousePos;
 
-		Score prevUpdateScore;
-
 		struct InputNotes
 		{
 			Note tap;
@@ -162,6 +160,31 @@ namespace MikuMikuWorld
 		} noteTransformOrigin;
 
 		std::vector<StepDrawData> drawSteps;
+
+		// Set while drawing the paste preview so notes outside the view are drawn as well
+		bool cullOffscreen{ true };
+
+		struct PreviewQuad
+		{
+			Quad quad;
+			float top;
+			float bottom;
+		};
+
+		// The paste preview drawn once with no offset. Moving it only translates the quads,
+		// so it is drawn again only for new paste data or when the note scale changes
+		struct PastePreview
+		{
+			std::vector<PreviewQuad> quads;
+			std::vector<StepDrawData> steps;
+			Vector2 origin;
+			unsigned int pasteVersion{};
+			float zoom{};
+			float laneWidth{};
+			float notesHeight{};
+			int selectedLayer{};
+			bool stepOutlines{};
+		} pastePreview;
 		std::unordered_set<std::string> playingNoteSounds;
 		static constexpr float audioOffsetCorrection = 0.02f;
 		static constexpr float audioLookAhead = 0.05f;
@@ -177,8 +200,14 @@ namespace MikuMikuWorld
 		                   const float endAlpha = 1,
 		                   const GuideColor guideColor = GuideColor::Green,
 		                   const int selectedLayer = -1);
-		void drawHoldNote(const std::unordered_map<int, Note>& notes, const HoldNote& note,
-		                  Renderer* renderer, const Color& tint, const int selectedLayer = -1,
+		void drawHoldSegment(const HoldSegment& segment, bool isGuide, Renderer* renderer,
+		                     const Color& tint, const int offsetTick = 0,
+		                     const int offsetLane = 0,
+		                     const GuideColor guideColor = GuideColor::Green,
+		                     const int selectedLayer = -1);
+		void drawHoldNote(const SlotMap<Note>& notes, const HoldNote& note,
+		                  const std::vector<HoldSegment>& segments, Renderer* renderer,
+		                  const Color& tint, const int selectedLayer = -1,
 		                  const int offsetTicks = 0, const int offsetLane = 0);
 		void drawHoldMid(Note& note, HoldStepType type, Renderer* renderer, const Color& tint,
 		                 const bool selectedLayer = true);
@@ -210,6 +239,7 @@ namespace MikuMikuWorld
 
 		void drawInputNote(Renderer* renderer);
 		void previewInput(const ScoreContext& context, EditArgs& edit, Renderer* renderer);
+		void buildPastePreview(const ScoreContext& context, Renderer* renderer);
 		void previewPaste(ScoreContext& context, Renderer* renderer);
 		void executeInput(ScoreContext& context, EditArgs& edit);
 		void eventEditor(ScoreContext& context);
@@ -274,10 +304,13 @@ namespace MikuMikuWorld
 		void setDivision(int div) { division = std::clamp(div, 4, 1920); }
 
 		constexpr inline bool isMouseInTimeline() const { return mouseInTimeline; }
+		bool isTickVisible(int tick) const;
 		bool isNoteVisible(const Note& note, int offsetTicks = 0) const;
+		int getVisibleStartTick() const;
+		int getVisibleEndTick() const;
 
 		int findClosestHold(ScoreContext& context, int lane, int tick);
-		bool isMouseInHoldPath(const Note& n1, const Note& n2, EaseType ease, float x, float y);
+		bool isMouseInHoldPath(const HoldSegment& segment, float x, float y);
 		constexpr inline bool isPlaying() const { return playing; }
 		void setPlaying(ScoreContext& context, bool state);
 		void stop(ScoreContext& context);
@@ -815,6 +815,15 @@ namespace MikuMikuWorld
 						UI::endPropertyColumns();
 					}
 
+					if (ImGui::CollapsingHeader(getString("history"),
+						ImGuiTreeNodeFlags_DefaultOpen))
+					{
+						UI::beginPropertyColumns();
+						UI::addIntProperty(getString("history_memory_limit"),
+							config.historyMemoryLimit);
+						UI::endPropertyColumns();
+					}
+
 					if (ImGui::CollapsingHeader(getString("theme"), ImGuiTreeNodeFlags_DefaultOpen))
 					{
 						UI::beginPropertyColumns();
@@ -1119,7 +1128,6 @@ namespace MikuMikuWorld
 
 			if (moveUpPattern != -1)
 			{
-				Score prev = context.score;
 				std::swap(context.score.layers[moveUpPattern],
 					context.score.layers[moveUpPattern - 1]);
 				for (auto& [_, note] : context.score.notes)
@@ -1136,12 +1144,12 @@ namespace MikuMikuWorld
 					else if (hiSpeed.layer == moveUpPattern - 1)
 						hiSpeed.layer = moveUpPattern;
 				}
-				context.pushHistory("Change Layer Order", prev, context.score);
+				context.score.invalidateHiSpeedIndex();
+				context.pushHistory("Change Layer Order");
 			}
 
 			if (moveDownPattern != -1)
 			{
-				Score prev = context.score;
 				std::swap(context.score.layers[moveDownPattern],
 					context.score.layers[moveDownPattern + 1]);
 				for (auto& [_, note] : context.score.notes)
@@ -1158,12 +1166,12 @@ namespace MikuMikuWorld
 					else if (hiSpeed.layer == moveDownPattern + 1)
 						hiSpeed.layer = moveDownPattern;
 				}
-				context.pushHistory("Change Layer Order", prev, context.score);
+				context.score.invalidateHiSpeedIndex();
+				context.pushHistory("Change Layer Order");
 			}
 
 			if (mergePattern != -1)
 			{
-				Score prev = context.score;
 				context.score.layers.erase(context.score.layers.begin() + mergePattern);
 				for (auto& [_, note] : context.score.notes)
 				{
@@ -1175,9 +1183,10 @@ namespace MikuMikuWorld
 					if (hiSpeed.layer > mergePattern)
 						hiSpeed.layer -= 1;
 				}
+				context.score.invalidateHiSpeedIndex();
 				if (context.selectedLayer > mergePattern)
 					context.selectedLayer -= 1;
-				context.pushHistory("Merge Layer", prev, context.score);
+				context.pushHistory("Merge Layer");
 			}
 		}
 
@@ -1195,16 +1204,18 @@ namespace MikuMikuWorld
 			if (renameIndex >= 0)
 			{
 				context.score.layers[renameIndex].name = layerName;
+				context.pushHistory("Rename Layer");
 				renameIndex = -1;
 			}
 			else
 			{
 				context.score.layers.push_back(Layer{ layerName });
 
-				int id = nextHiSpeedID++;
-				context.score.hiSpeedChanges[id] = {
+				int id = context.score.allocateHiSpeedID();
+				context.score.addHiSpeedChange({
 					id, 0, 1, static_cast<int>(context.score.layers.size()) - 1
-				};
+				});
+				context.pushHistory("Create Layer");
 				layerName.clear();
 			}
 		}
@@ -1294,6 +1305,7 @@ namespace MikuMikuWorld
 				context.score.waypoints.push_back(Waypoint{ "New Waypoint", context.currentTick });
 				std::sort(context.score.waypoints.begin(), context.score.waypoints.end(),
 					[](const Waypoint& a, const Waypoint& b) { return a.tick < b.tick; });
+				context.pushHistory("Create Waypoint");
 			}
 
 			ImGui::PopStyleColor();
@@ -0,0 +1,401 @@
+#include "ScoreIndex.h"
+#include "Score.h"
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+namespace MikuMikuWorld
+{
+	static bool compareNoteEntries(const NoteTickEntry& a, const NoteTickEntry& b)
+	{
+		return a.tick == b.tick ? a.ID < b.ID : a.tick < b.tick;
+	}
+
+	static bool compareHiSpeedEntries(const HiSpeedTickEntry& a, const HiSpeedTickEntry& b)
+	{
+		return a.tick == b.tick ? a.ID < b.ID : a.tick < b.tick;
+	}
+
+	HoldPoint toHoldPoint(const Note& note)
+	{
+		return { note.tick, note.lane, note.width, note.layer, note.critical };
+	}
+
+	void resolveHoldSegments(const SlotMap<Note>& notes, const HoldNote& hold,
+	                         std::vector<HoldSegment>& segments)
+	{
+		segments.clear();
+
+		const Note& start = notes.at(hold.start.ID);
+		const Note& end = notes.at(hold.end);
+		const int length = abs(end.tick - start.tick);
+		auto getAlpha = [&](float progress)
+		{
+			if (!hold.isGuide() || hold.fadeType == FadeType::None)
+				return 1.0f;
+
+			return hold.fadeType == FadeType::In ? progress : 1 - progress;
+		};
+		auto getProgress = [&](const Note& note)
+		{ return length > 0 ? (note.tick - start.tick) / (float)length : 0.0f; };
+
+		// Holds with steps but no length have no visible path
+		if (hold.steps.size() && length == 0)
+			return;
+
+		const Note* from = &start;
+		EaseType ease = hold.start.ease;
+		for (const auto& step : hold.steps)
+		{
+			if (step.type == HoldStepType::Skip)
+				continue;
+
+			const Note& to = notes.at(step.ID);
+			segments.push_back({ toHoldPoint(*from), toHoldPoint(to), ease,
+			                     getAlpha(getProgress(*from)), getAlpha(getProgress(to)) });
+
+			from = &to;
+			ease = step.ease;
+		}
+
+		segments.push_back({ toHoldPoint(*from), toHoldPoint(end), ease,
+		                     getAlpha(getProgress(*from)), getAlpha(1.0f) });
+	}
+
+	void NoteTickIndex::rebuild(const SlotMap<Note>& notes)
+	{
+		entries.clear();
+		entries.reserve(notes.size());
+		for (const auto& [id, note] : notes)
+			entries.push_back({ note.tick, id });
+
+		std::sort(entries.begin(), entries.end(), compareNoteEntries);
+		dirty = false;
+	}
+
+	void NoteTickIndex::insert(int tick, int id)
+	{
+		if (dirty)
+			return;
+
+		NoteTickEntry entry{ tick, id };
+		entries.insert(std::upper_bound(entries.begin(), entries.end(), entry, compareNoteEntries),
+		               entry);
+	}
+
+	void NoteTickIndex::erase(int tick, int id)
+	{
+		if (dirty)
+			return;
+
+		NoteTickEntry entry{ tick, id };
+		auto it = std::lower_bound(entries.begin(), entries.end(), entry, compareNoteEntries);
+		if (it != entries.end() && it->tick == tick && it->ID == id)
+			entries.erase(it);
+		else
+			dirty = true;
+	}
+
+	void NoteTickIndex::move(int id, int oldTick, int newTick)
+	{
+		if (dirty || oldTick == newTick)
+			return;
+
+		NoteTickEntry entry{ oldTick, id };
+		auto it = std::lower_bound(entries.begin(), entries.end(), entry, compareNoteEntries);
+		if (it == entries.end() || it->tick != oldTick || it->ID != id)
+		{
+			dirty = true;
+			return;
+		}
+
+		// Shift the entries between the old and new position instead of erasing and inserting
+		it->tick = newTick;
+		if (newTick > oldTick)
+		{
+			auto next = std::upper_bound(it + 1, entries.end(), *it, compareNoteEntries);
+			std::rotate(it, it + 1, next);
+		}
+		else
+		{
+			auto prev = std::upper_bound(entries.begin(), it, *it, compareNoteEntries);
+			std::rotate(prev, it, it + 1);
+		}
+	}
+
+	void NoteTickIndex::query(int begin, int end, std::vector<int>& ids) const
+	{
+		auto first = std::lower_bound(entries.begin(), entries.end(), begin,
+		                              [](const NoteTickEntry& e, int tick) { return e.tick < tick; });
+		for (auto it = first; it != entries.end() && it->tick <= end; ++it)
+			ids.push_back(it->ID);
+	}
+
+	void HoldTickIndex::rebuild(const SlotMap<Note>& notes,
+	                            const std::unordered_map<int, HoldNote>& holds)
+	{
+		entries.clear();
+		entries.reserve(holds.size());
+		maxLength = 0;
+		for (const auto& [id, hold] : holds)
+		{
+			auto start = notes.find(hold.start.ID);
+			auto end = notes.find(hold.end);
+			if (start == notes.end() || end == notes.end())
+				continue;
+
+			int minTick = std::min(start->second.tick, end->second.tick);
+			int maxTick = std::max(start->second.tick, end->second.tick);
+			for (const auto& step : hold.steps)
+			{
+				auto mid = notes.find(step.ID);
+				if (mid == notes.end())
+					continue;
+
+				minTick = std::min(minTick, mid->second.tick);
+				maxTick = std::max(maxTick, mid->second.tick);
+			}
+
+			entries.push_back({ minTick, maxTick, id });
+			maxLength = std::max(maxLength, maxTick - minTick);
+		}
+
+		std::sort(entries.begin(), entries.end(), [](const HoldTickEntry& a, const HoldTickEntry& b)
+		          { return a.startTick == b.startTick ? a.ID < b.ID : a.startTick < b.startTick; });
+		dirty = false;
+	}
+
+	void HoldTickIndex::query(int begin, int end, std::vector<int>& ids) const
+	{
+		// Any hold starting before (begin - maxLength) has already ended before begin
+		int minStart = begin < std::numeric_limits<int>::min() + maxLength
+		                   ? std::numeric_limits<int>::min()
+		                   : begin - maxLength;
+		auto first =
+		    std::lower_bound(entries.begin(), entries.end(), minStart,
+		                     [](const HoldTickEntry& e, int tick) { return e.startTick < tick; });
+		for (auto it = first; it != entries.end() && it->startTick <= end; ++it)
+		{
+			if (it->endTick >= begin)
+				ids.push_back(it->ID);
+		}
+	}
+
+	bool HiSpeedIndex::isValid(const std::unordered_map<int, HiSpeedChange>& hiSpeeds) const
+	{
+		return !dirty && count == hiSpeeds.size();
+	}
+
+	void HiSpeedIndex::rebuild(const std::unordered_map<int, HiSpeedChange>& hiSpeeds)
+	{
+		layers.clear();
+		for (const auto& [id, hiSpeed] : hiSpeeds)
+		{
+			if (hiSpeed.layer < 0)
+				continue;
+
+			if (hiSpeed.layer >= layers.size())
+				layers.resize(hiSpeed.layer + 1);
+
+			layers[hiSpeed.layer].push_back({ hiSpeed.tick, id });
+		}
+
+		for (auto& layer : layers)
+			std::sort(layer.begin(), layer.end(), compareHiSpeedEntries);
+
+		count = hiSpeeds.size();
+		dirty = false;
+	}
+
+	void HiSpeedIndex::insert(const HiSpeedChange& hiSpeed)
+	{
+		if (dirty || hiSpeed.layer < 0)
+		{
+			dirty = true;
+			return;
+		}
+
+		if (hiSpeed.layer >= layers.size())
+			layers.resize(hiSpeed.layer + 1);
+
+		auto& layer = layers[hiSpeed.layer];
+		HiSpeedTickEntry entry{ hiSpeed.tick, hiSpeed.ID };
+		layer.insert(std::upper_bound(layer.begin(), layer.end(), entry, compareHiSpeedEntries),
+		             entry);
+		count++;
+	}
+
+	void HiSpeedIndex::erase(const HiSpeedChange& hiSpeed)
+	{
+		if (dirty || hiSpeed.layer < 0 || hiSpeed.layer >= layers.size())
+		{
+			dirty = true;
+			return;
+		}
+
+		auto& layer = layers[hiSpeed.layer];
+		HiSpeedTickEntry entry{ hiSpeed.tick, hiSpeed.ID };
+		auto it = std::lower_bound(layer.begin(), layer.end(), entry, compareHiSpeedEntries);
+		if (it != layer.end() && it->tick == hiSpeed.tick && it->ID == hiSpeed.ID)
+		{
+			layer.erase(it);
+			count--;
+		}
+		else
+		{
+			dirty = true;
+		}
+	}
+
+	void HiSpeedIndex::move(const HiSpeedChange& hiSpeed, int newTick)
+	{
+		if (dirty || hiSpeed.tick == newTick)
+			return;
+
+		erase(hiSpeed);
+		HiSpeedChange moved = hiSpeed;
+		moved.tick = newTick;
+		insert(moved);
+	}
+
+	int HiSpeedIndex::findActive(int tick, int layer) const
+	{
+		auto findInLayer = [tick](const std::vector<HiSpeedTickEntry>& entries)
+		{
+			auto it = std::upper_bound(entries.begin(), entries.end(), tick,
+			                           [](int t, const HiSpeedTickEntry& e) { return t < e.tick; });
+			return it == entries.begin() ? nullptr : &*std::prev(it);
+		};
+
+		if (layer != -1)
+		{
+			if (layer < 0 || layer >= layers.size())
+				return -1;
+
+			const HiSpeedTickEntry* entry = findInLayer(layers[layer]);
+			return entry ? entry->ID : -1;
+		}
+
+		const HiSpeedTickEntry* latest = nullptr;
+		for (const auto& entries : layers)
+		{
+			const HiSpeedTickEntry* entry = findInLayer(entries);
+			if (entry && (!latest || compareHiSpeedEntries(*latest, *entry)))
+				latest = entry;
+		}
+
+		return latest ? latest->ID : -1;
+	}
+
+	void HiSpeedIndex::query(int begin, int end, int layer, std::vector<int>& ids) const
+	{
+		auto findFirst = [begin](const std::vector<HiSpeedTickEntry>& entries)
+		{
+			return std::lower_bound(entries.begin(), entries.end(), begin,
+			                        [](const HiSpeedTickEntry& e, int t) { return e.tick < t; });
+		};
+
+		if (layer != -1)
+		{
+			if (layer < 0 || layer >= layers.size())
+				return;
+
+			const auto& entries = layers[layer];
+			for (auto it = findFirst(entries); it != entries.end() && it->tick <= end; ++it)
+				ids.push_back(it->ID);
+
+			return;
+		}
+
+		std::vector<HiSpeedTickEntry> merged;
+		for (const auto& entries : layers)
+			for (auto it = findFirst(entries); it != entries.end() && it->tick <= end; ++it)
+				merged.push_back(*it);
+
+		std::sort(merged.begin(), merged.end(), compareHiSpeedEntries);
+		for (const auto& entry : merged)
+			ids.push_back(entry.ID);
+	}
+
+	void NoteColumns::rebuild(const SlotMap<Note>& notes)
+	{
+		const size_t count = notes.size();
+		ids.resize(count);
+		ticks.resize(count);
+		lanes.resize(count);
+		widths.resize(count);
+		layers.resize(count);
+		types.resize(count);
+		flags.resize(count);
+
+		size_t i = 0;
+		for (const auto& [id, note] : notes)
+		{
+			ids[i] = id;
+			ticks[i] = note.tick;
+			lanes[i] = note.lane;
+			widths[i] = note.width;
+			layers[i] = note.layer;
+			types[i] = static_cast<uint8_t>(note.getType());
+			flags[i] = (note.critical ? FLAG_CRITICAL : 0) | (note.friction ? FLAG_FRICTION : 0) |
+			           (note.isFlick() ? FLAG_FLICK : 0);
+			++i;
+		}
+
+		dirty = false;
+	}
+
+	NoteTypeCounts NoteColumns::countTypes() const
+	{
+		constexpr uint8_t tap = static_cast<uint8_t>(NoteType::Tap);
+		constexpr uint8_t hold = static_cast<uint8_t>(NoteType::Hold);
+		constexpr uint8_t holdMid = static_cast<uint8_t>(NoteType::HoldMid);
+
+		int taps = 0, flicks = 0, holds = 0, steps = 0, traces = 0;
+		const size_t count = types.size();
+		const uint8_t* t = types.data();
+		const uint8_t* f = flags.data();
+		for (size_t i = 0; i < count; ++i)
+		{
+			taps += (t[i] == tap) & ((f[i] & (FLAG_FLICK | FLAG_FRICTION)) == 0);
+			flicks += (f[i] & FLAG_FLICK) != 0;
+			holds += t[i] == hold;
+			steps += t[i] == holdMid;
+			traces += (f[i] & FLAG_FRICTION) != 0;
+		}
+
+		return { taps, flicks, holds, steps, traces };
+	}
+
+	void NoteColumns::queryRect(float minTick, float maxTick, float minLane, float maxLane,
+	                            int layer, std::vector<int>& result) const
+	{
+		const size_t count = ids.size();
+		const int* tick = ticks.data();
+		const int* lane = lanes.data();
+		const int* width = widths.data();
+		const int* noteLayer = layers.data();
+
+		// Build a hit mask in one pass, then gather the hits
+		std::vector<uint8_t> hits(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			hits[i] = (tick[i] >= minTick) & (tick[i] <= maxTick) & (lane[i] < maxLane) &
+			          (lane[i] + width[i] > minLane) & ((layer == -1) | (noteLayer[i] == layer));
+		}
+
+		for (size_t i = 0; i < count; ++i)
+			if (hits[i])
+				result.push_back(ids[i]);
+	}
+
+	const std::vector<HoldSegment>& HoldGeometryCache::get(int holdID, const SlotMap<Note>& notes,
+	                                                       const HoldNote& hold)
+	{
+		auto [it, inserted] = entries.try_emplace(holdID);
+		if (inserted)
+			resolveHoldSegments(notes, hold, it->second);
+
+		return it->second;
+	}
+}
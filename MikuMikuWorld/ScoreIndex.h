@@ -0,0 +1,185 @@
+#pragma once
+#include "Note.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace MikuMikuWorld
+{
+	struct HiSpeedChange;
+
+	struct NoteTickEntry
+	{
+		int tick;
+		int ID;
+	};
+
+	struct HoldTickEntry
+	{
+		int startTick;
+		int endTick;
+		int ID;
+	};
+
+	struct HiSpeedTickEntry
+	{
+		int tick;
+		int ID;
+	};
+
+	struct NoteTypeCounts
+	{
+		int taps{};
+		int flicks{};
+		int holds{};
+		int steps{};
+		int traces{};
+	};
+
+	struct HoldPoint
+	{
+		int tick;
+		int lane;
+		int width;
+		int layer;
+		bool critical;
+	};
+
+	// Part of a hold's path between two points that are not skip steps
+	struct HoldSegment
+	{
+		HoldPoint from;
+		HoldPoint to;
+		EaseType ease;
+		float fromAlpha;
+		float toAlpha;
+	};
+
+	HoldPoint toHoldPoint(const Note& note);
+	void resolveHoldSegments(const SlotMap<Note>& notes, const HoldNote& hold,
+	                         std::vector<HoldSegment>& segments);
+
+	// Note IDs sorted by tick. Rebuilt lazily after being invalidated,
+	// single note moves are applied in place.
+	class NoteTickIndex
+	{
+	  private:
+		std::vector<NoteTickEntry> entries;
+		bool dirty{ true };
+
+	  public:
+		inline void invalidate() { dirty = true; }
+		inline bool isValid(const SlotMap<Note>& notes) const
+		{
+			return !dirty && entries.size() == notes.size();
+		}
+
+		void rebuild(const SlotMap<Note>& notes);
+		void insert(int tick, int id);
+		void erase(int tick, int id);
+		void move(int id, int oldTick, int newTick);
+
+		// Appends the IDs of notes in the range [begin, end] in tick order
+		void query(int begin, int end, std::vector<int>& ids) const;
+	};
+
+	// Holds sorted by their earliest tick. The range of a hold spans its start, end and steps
+	class HoldTickIndex
+	{
+	  private:
+		std::vector<HoldTickEntry> entries;
+		int maxLength{};
+		bool dirty{ true };
+
+	  public:
+		inline void invalidate() { dirty = true; }
+		inline bool isValid(const std::unordered_map<int, HoldNote>& holds) const
+		{
+			return !dirty && entries.size() == holds.size();
+		}
+
+		void rebuild(const SlotMap<Note>& notes,
+		             const std::unordered_map<int, HoldNote>& holds);
+
+		// Appends the IDs of holds overlapping the range [begin, end]
+		void query(int begin, int end, std::vector<int>& ids) const;
+	};
+
+	// Hi-speed change IDs sorted by tick for each layer.
+	// A layer of -1 in lookups refers to all layers.
+	class HiSpeedIndex
+	{
+	  private:
+		std::vector<std::vector<HiSpeedTickEntry>> layers;
+		size_t count{};
+		bool dirty{ true };
+
+	  public:
+		inline void invalidate() { dirty = true; }
+		bool isValid(const std::unordered_map<int, HiSpeedChange>& hiSpeeds) const;
+
+		void rebuild(const std::unordered_map<int, HiSpeedChange>& hiSpeeds);
+		void insert(const HiSpeedChange& hiSpeed);
+		void erase(const HiSpeedChange& hiSpeed);
+		void move(const HiSpeedChange& hiSpeed, int newTick);
+
+		// Returns the ID of the last change at or before tick or -1 if there is none
+		int findActive(int tick, int layer) const;
+
+		// Appends the IDs of changes in the range [begin, end] in tick order
+		void query(int begin, int end, int layer, std::vector<int>& ids) const;
+	};
+
+	// Read-only copy of the notes with one array per field, in the order of Score::notes.
+	// The passes over it are branch-free loops so the compiler can vectorize them.
+	class NoteColumns
+	{
+	  public:
+		enum Flags : uint8_t
+		{
+			FLAG_CRITICAL = 1 << 0,
+			FLAG_FRICTION = 1 << 1,
+			FLAG_FLICK = 1 << 2
+		};
+
+	  private:
+		std::vector<int> ids;
+		std::vector<int> ticks;
+		std::vector<int> lanes;
+		std::vector<int> widths;
+		std::vector<int> layers;
+		std::vector<uint8_t> types;
+		std::vector<uint8_t> flags;
+		bool dirty{ true };
+
+	  public:
+		inline void invalidate() { dirty = true; }
+		inline bool isValid(const SlotMap<Note>& notes) const
+		{
+			return !dirty && ids.size() == notes.size();
+		}
+
+		void rebuild(const SlotMap<Note>& notes);
+
+		NoteTypeCounts countTypes() const;
+
+		// Appends the IDs of notes with a tick in [minTick, maxTick] overlapping the lanes
+		// (minLane, maxLane). A layer of -1 matches all layers.
+		void queryRect(float minTick, float maxTick, float minLane, float maxLane, int layer,
+		               std::vector<int>& result) const;
+	};
+
+	// Resolved hold segments. Invalidating a hold drops its entry so only that hold is
+	// resolved again the next time it is requested.
+	class HoldGeometryCache
+	{
+	  private:
+		std::unordered_map<int, std::vector<HoldSegment>> entries;
+
+	  public:
+		inline void invalidate(int holdID) { entries.erase(holdID); }
+
+		const std::vector<HoldSegment>& get(int holdID, const SlotMap<Note>& notes,
+		                                    const HoldNote& hold);
+	};
+}
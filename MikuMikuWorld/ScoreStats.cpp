@@ -28,23 +28,12 @@ namespace MikuMikuWorld
 
 	void ScoreStats::calculateStats(const Score& score)
 	{
-		taps = std::count_if(score.notes.begin(), score.notes.end(), [](const auto& n)
-			{
-				const Note& note = n.second;
-				return note.getType() == NoteType::Tap && !note.isFlick() && !note.friction;
-			});
-
-		holds = std::count_if(score.notes.begin(), score.notes.end(),
-			[](const auto& n) { return n.second.getType() == NoteType::Hold; });
-
-		steps = std::count_if(score.notes.begin(), score.notes.end(),
-			[](const auto& n) { return n.second.getType() == NoteType::HoldMid; });
-
-		flicks = std::count_if(score.notes.begin(), score.notes.end(),
-			[](const auto& n) { return n.second.isFlick(); });
-
-		traces = std::count_if(score.notes.begin(), score.notes.end(),
-			[](const auto& n) { return n.second.friction; });
+		const NoteTypeCounts counts = score.getNoteColumns().countTypes();
+		taps = counts.taps;
+		holds = counts.holds;
+		steps = counts.steps;
+		flicks = counts.flicks;
+		traces = counts.traces;
 
 		total = score.notes.size();
 		calculateCombo(score);
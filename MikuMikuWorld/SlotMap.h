@@ -0,0 +1,150 @@
+#pragma once
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace MikuMikuWorld
+{
+	// Values keyed by non-negative IDs, stored contiguously for iteration.
+	// The ID indexes a slot pointing into the value array so lookups don't hash.
+	// Erasing moves the last value into the erased position.
+	template <typename T>
+	class SlotMap
+	{
+	  public:
+		using value_type = std::pair<int, T>;
+		using iterator = typename std::vector<value_type>::iterator;
+		using const_iterator = typename std::vector<value_type>::const_iterator;
+
+		// Refers to a value only as long as it is not erased, even if its ID is inserted again
+		struct Handle
+		{
+			int ID{ -1 };
+			unsigned int generation{};
+		};
+
+	  private:
+		struct Slot
+		{
+			int index{ -1 };
+			unsigned int generation{};
+		};
+
+		std::vector<value_type> values;
+		std::vector<Slot> slots;
+
+		inline int indexOf(int id) const
+		{
+			return id >= 0 && id < slots.size() ? slots[id].index : -1;
+		}
+
+	  public:
+		inline iterator begin() { return values.begin(); }
+		inline iterator end() { return values.end(); }
+		inline const_iterator begin() const { return values.begin(); }
+		inline const_iterator end() const { return values.end(); }
+
+		inline size_t size() const { return values.size(); }
+		inline bool empty() const { return values.empty(); }
+		inline void reserve(size_t count) { values.reserve(count); }
+
+		inline size_t count(int id) const { return indexOf(id) == -1 ? 0 : 1; }
+
+		inline iterator find(int id)
+		{
+			int index = indexOf(id);
+			return index == -1 ? values.end() : values.begin() + index;
+		}
+
+		inline const_iterator find(int id) const
+		{
+			int index = indexOf(id);
+			return index == -1 ? values.end() : values.begin() + index;
+		}
+
+		T& at(int id)
+		{
+			int index = indexOf(id);
+			if (index == -1)
+				throw std::out_of_range("Invalid slot map ID");
+
+			return values[index].second;
+		}
+
+		const T& at(int id) const
+		{
+			int index = indexOf(id);
+			if (index == -1)
+				throw std::out_of_range("Invalid slot map ID");
+
+			return values[index].second;
+		}
+
+		T& operator[](int id)
+		{
+			int index = indexOf(id);
+			if (index != -1)
+				return values[index].second;
+
+			if (id < 0)
+				throw std::out_of_range("Invalid slot map ID");
+
+			if (id >= slots.size())
+				slots.resize(id + 1);
+
+			slots[id].index = values.size();
+			values.emplace_back(id, T{});
+			return values.back().second;
+		}
+
+		size_t erase(int id)
+		{
+			int index = indexOf(id);
+			if (index == -1)
+				return 0;
+
+			if (index != values.size() - 1)
+			{
+				values[index] = std::move(values.back());
+				slots[values[index].first].index = index;
+			}
+
+			values.pop_back();
+			slots[id].index = -1;
+			slots[id].generation++;
+			return 1;
+		}
+
+		void clear()
+		{
+			for (const auto& [id, _] : values)
+			{
+				slots[id].index = -1;
+				slots[id].generation++;
+			}
+
+			values.clear();
+		}
+
+		inline Handle getHandle(int id) const
+		{
+			return indexOf(id) == -1 ? Handle{} : Handle{ id, slots[id].generation };
+		}
+
+		inline T* get(Handle handle)
+		{
+			int index = indexOf(handle.ID);
+			return index != -1 && slots[handle.ID].generation == handle.generation
+			           ? &values[index].second
+			           : nullptr;
+		}
+
+		inline const T* get(Handle handle) const
+		{
+			int index = indexOf(handle.ID);
+			return index != -1 && slots[handle.ID].generation == handle.generation
+			           ? &values[index].second
+			           : nullptr;
+		}
+	};
+}
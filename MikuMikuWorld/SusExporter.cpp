@@ -3,8 +3,8 @@
 #include "IO.h"
 #include "File.h"
 #include <algorithm>
+#include <map>
 #include <numeric>
-#include <unordered_set>
 
 using namespace IO;
 
@@ -32,7 +32,7 @@ namespace MikuMikuWorld
 			channels[i] = TickRange{ 0, 0 };
 	}
 
-	SusExporter::SusExporter() : ticksPerBeat{ 480 }
+	SusExporter::SusExporter() : ticksPerBeat{ 480 }, baseMeasure{ 0 }
 	{
 
 	}
@@ -52,19 +52,37 @@ namespace MikuMikuWorld
 		return blt.ticks + (measureDiff * ticksPerMeasure);
 	}
 
+	const BarLengthTicks* SusExporter::findBarLength(int ticks) const
+	{
+		// Bar lengths are stored from the last one to the first
+		auto it = std::partition_point(barLengthTicks.begin(), barLengthTicks.end(),
+			[ticks](const BarLengthTicks& blt) { return blt.ticks > ticks; });
+
+		return it != barLengthTicks.end() ? &*it : nullptr;
+	}
+
 	int SusExporter::getMeasureFromTicks(int ticks)
 	{
-		for (const auto& [barLength, barTicks] : barLengthTicks)
-		{
-			if (ticks >= barTicks)
-				return barLength.bar + ((float)(ticks - barTicks) / (float)ticksPerBeat / barLength.length);
-		}
+		const BarLengthTicks* blt = findBarLength(ticks);
 
 		// no time signatures
-		return 0;
+		if (!blt)
+			return 0;
+
+		return blt->barLength.bar + ((float)(ticks - blt->ticks) / (float)ticksPerBeat / blt->barLength.length);
 	}
 
-	void SusExporter::appendSlideData(const SUSNoteStream& slides, const std::string& infoPrefix)
+	void SusExporter::setBaseMeasure(int measure, std::string& output)
+	{
+		int base = (measure / 1000) * 1000;
+		if (base != baseMeasure)
+		{
+			output.append("#MEASUREBS ").append(std::to_string(base)).push_back('\n');
+			baseMeasure = base;
+		}
+	}
+
+	void SusExporter::appendSlideData(const SUSNoteStream& slides, char infoPrefix)
 	{
 		ChannelProvider channelProvider;
 		for (const auto& slide : slides)
@@ -73,141 +91,154 @@ namespace MikuMikuWorld
 			int endTick = slide.rbegin()->tick;
 			int channel = channelProvider.generateChannel(startTick, endTick);
 
-			char buf[10]{};
-			std::string chStr(tostringBaseN(buf, channel, 36));
 			for (const auto& note : slide)
-				appendNoteData(note, infoPrefix, chStr);
+				appendNoteData(note, infoPrefix, channel);
 		}
 	};
 
-	void SusExporter::appendData(int tick, std::string info, std::string data, std::string hiSpeedGroup)
+	void SusExporter::appendNoteData(const SUSNote& note, char infoPrefix, int channel)
 	{
-		for (const auto& [barLength, barTicks] : barLengthTicks)
-		{
-			if (tick >= barTicks)
-			{
-				int currentMeasure = barLength.bar + ((float)(tick - barTicks) / (float)ticksPerBeat / barLength.length);
-				MeasureMap& measureMap = measuresMap[currentMeasure];
-				measureMap.measure = currentMeasure;
-
-				NoteMap& map = measureMap.notesMap[info];
-				map.data.push_back(NoteMap::RawData{ tick - barTicks, data, hiSpeedGroup });
-				map.ticksPerMeasure = barLength.length * ticksPerBeat;
-				break;
-			}
-		}
+		const BarLengthTicks* blt = findBarLength(note.tick);
+		if (!blt)
+			return;
+
+		int ticksPerMeasure = blt->barLength.length * ticksPerBeat;
+		if (ticksPerMeasure <= 0)
+			return;
+
+		int measure = getMeasureFromTicks(note.tick);
+		if (measure < 0)
+			return;
+
+		if (measure >= measureCells.size())
+			measureCells.resize(measure + 1);
+
+		auto [group, inserted] =
+			hiSpeedGroupIndices.try_emplace(note.hiSpeedGroup, hiSpeedGroups.size());
+		if (inserted)
+			hiSpeedGroups.push_back(note.hiSpeedGroup);
+
+		// Lanes, channels, types and widths are all a single base 36 digit
+		auto digit = [](int value) { return digits[std::clamp(value, 0, 35)]; };
+
+		NoteCell cell{};
+		cell.tick = (note.tick - blt->ticks) % ticksPerMeasure;
+		cell.ticksPerMeasure = ticksPerMeasure;
+		cell.hiSpeedGroup = group->second;
+		cell.info = { infoPrefix, digit(note.lane), channel != -1 ? digit(channel) : '\0', '\0' };
+		cell.data = { digit(note.type), digit(note.width) };
+		measureCells[measure].push_back(cell);
 	}
 
-	void SusExporter::appendNoteData(const SUSNote& note, const std::string infoPrefix, const std::string channel)
+	void SusExporter::writeNoteLines(std::string& output)
 	{
-		char buff1[10];
-		std::string info = infoPrefix + tostringBaseN(buff1, note.lane, 36);
-		if (channel != "-1")
-			info.append(channel);
+		// Hi-speed groups are written in name order
+		std::vector<int> groupOrder(hiSpeedGroups.size());
+		std::iota(groupOrder.begin(), groupOrder.end(), 0);
+		std::sort(groupOrder.begin(), groupOrder.end(),
+			[this](int a, int b) { return hiSpeedGroups[a] < hiSpeedGroups[b]; });
 
-		char buff2[10];
-		appendData(note.tick, info, std::to_string(note.type) + tostringBaseN(buff2, note.width, 36), note.hiSpeedGroup);
-	}
+		std::vector<int> groupRanks(hiSpeedGroups.size());
+		for (int i = 0; i < groupOrder.size(); ++i)
+			groupRanks[groupOrder[i]] = i;
 
-	std::vector<std::string> SusExporter::getNoteLines(int baseMeasure)
-	{
-		std::vector<std::string> lines;
+		// Lines are ordered by group rank then header, packed into one integer
+		auto lineLess = [](const NoteCell& a, const NoteCell& b) { return a.line < b.line; };
 
-		// Notes on the same tick and lane
-		std::vector<NoteMap::RawData> conflicts;
+		// Line each cell goes on and the number of cells at each position of the line
+		std::vector<int> cellLines;
+		std::vector<int> positionCounts;
+		int currentHiSpeedGroup = -1;
 
-		// Holds possible note conflicts while processing other conflicts
-		std::vector<NoteMap::RawData> temp;
-
-		// Write note data
-		for (const auto& [measure, map] : measuresMap)
+		for (int measure = 0; measure < measureCells.size(); ++measure)
 		{
-			int measureTicks = getTicksFromMeasure(measure);
-			int base = (measure / 1000) * 1000;
-			int offset = measure % 1000;
-			if (base != baseMeasure)
+			std::vector<NoteCell>& cells = measureCells[measure];
+			if (cells.empty())
+				continue;
+
+			setBaseMeasure(measure, output);
+			for (NoteCell& cell : cells)
 			{
-				lines.push_back("#MEASUREBS " + std::to_string(base));
-				baseMeasure = base;
+				uint64_t info =
+					(uint8_t)cell.info[0] << 16 | (uint8_t)cell.info[1] << 8 | (uint8_t)cell.info[2];
+				cell.line = (uint64_t)groupRanks[cell.hiSpeedGroup] << 24 | info;
 			}
+			std::stable_sort(cells.begin(), cells.end(), lineLess);
+
+			auto first = cells.begin();
+			while (first != cells.end())
+			{
+				auto last = first + 1;
+				while (last != cells.end() && last->line == first->line)
+					++last;
+
+				if (first->hiSpeedGroup != currentHiSpeedGroup)
+				{
+					const std::string& group = hiSpeedGroups[first->hiSpeedGroup];
+					if (group.size())
+						output.append("#HISPEED ").append(group).push_back('\n');
+
+					currentHiSpeedGroup = first->hiSpeedGroup;
+				}
+
+				int ticksPerMeasure = first->ticksPerMeasure;
+				int gcd = ticksPerMeasure;
+				for (auto it = first; it != last; ++it)
+					gcd = std::gcd(it->tick, gcd);
+
+				// Number of notes including empty ones in a line
+				int dataCount = ticksPerMeasure / gcd;
+
+				// Notes on the same tick and lane are written on additional lines
+				positionCounts.assign(dataCount, 0);
+				cellLines.clear();
+				int lineCount = 1;
+				for (auto it = first; it != last; ++it)
+				{
+					int line = positionCounts[it->tick / gcd]++;
+					cellLines.push_back(line);
+					lineCount = std::max(lineCount, line + 1);
+				}
+
+				char header[32]{};
+				snprintf(header, sizeof(header), "#%03d%s:", measure - baseMeasure, first->info.data());
+				for (int line = 0; line < lineCount; ++line)
+				{
+					output.append(header);
+					size_t dataStart = output.size();
+					output.append(dataCount * 2, '0');
+					for (auto it = first; it != last; ++it)
+					{
+						if (cellLines[it - first] != line)
+							continue;
+
+						size_t index = dataStart + (it->tick / gcd) * 2;
+						output[index + 0] = it->data[0];
+						output[index + 1] = it->data[1];
+					}
+					output.push_back('\n');
+				}
+
+				first = last;
+			}
+
+			cells.clear();
+		}
 
-      std::unordered_set<std::string> hiSpeedGroups;
-			for (const auto& [_, notes] : map.notesMap) {
-        for (const auto& note : notes.data) {
-          if (std::find(hiSpeedGroups.begin(), hiSpeedGroups.end(), note.hiSpeedGroup) == hiSpeedGroups.end())
-            hiSpeedGroups.insert(note.hiSpeedGroup);
-        }
-      }
-      for (const auto& hiSpeedGroup : hiSpeedGroups) {
-        if (hiSpeedGroup.size() > 0)
-          lines.push_back(formatString("#HISPEED %s", hiSpeedGroup.c_str()));
-        for (const auto& [info, notes] : map.notesMap)
-        {
-          conflicts.clear();
-
-          int gcd = notes.ticksPerMeasure;
-          for (const auto& raw : notes.data) {
-            if (raw.hiSpeedGroup != hiSpeedGroup)
-              continue;
-            gcd = std::gcd(raw.tick, gcd);
-          }
-
-          // Number of notes including empty ones in a line
-          int dataCount = notes.ticksPerMeasure / gcd;
-          std::string data(dataCount * 2, '0');
-          for (const auto& raw : notes.data)
-          {
-            if (raw.hiSpeedGroup != hiSpeedGroup)
-              continue;
-            int index = (raw.tick % notes.ticksPerMeasure) / gcd * 2;
-            if (data.substr(index, 2) != "00")
-            {
-              conflicts.push_back(raw);
-            }
-            else
-            {
-              data[index + 0] = raw.data[0];
-              data[index + 1] = raw.data[1];
-            }
-          }
-
-          lines.push_back(formatString("#%03d%s:", measure - baseMeasure, info.c_str()) + data);
-
-          while (conflicts.size())
-          {
-            temp.clear();
-            std::string data2(dataCount * 2, '0');
-            for (const auto& item : conflicts)
-            {
-              int index = (item.tick % notes.ticksPerMeasure) / gcd * 2;
-              if (data2.substr(index, 2) != "00")
-              {
-                temp.push_back(item);
-              }
-              else
-              {
-                data2[index + 0] = item.data[0];
-                data2[index + 1] = item.data[1];
-              }
-            }
-
-            lines.push_back(formatString("#%03d%s:", measure - baseMeasure, info.c_str()) + data2);
-            conflicts = temp;
-          }
-        }
-      }
-    }
-
-		return lines;
+		hiSpeedGroups.clear();
+		hiSpeedGroupIndices.clear();
 	}
 
 	void SusExporter::dump(const SUS& sus, const std::string& filename, std::string comment)
 	{
-		std::vector<std::string> lines;
+		std::string output;
+		output.reserve((sus.taps.size() + sus.directionals.size()) * 16 + 4096);
+		auto writeLine = [&output](const std::string& line) { output.append(line).push_back('\n'); };
+
 		if (!comment.empty())
 		{
 			// Make sure the comment is ignored by parsers.
-			lines.push_back(comment.substr(comment.find_first_not_of("#")));
+			writeLine(comment.substr(comment.find_first_not_of("#")));
 		}
 
 		// Write metadata
@@ -216,14 +247,14 @@ namespace MikuMikuWorld
 			std::string key = attrKey;
 			std::transform(key.begin(), key.end(), key.begin(), ::toupper);
 
-			lines.push_back("#" + key + " \"" + attrValue + "\"");
+			writeLine("#" + key + " \"" + attrValue + "\"");
 		}
 
-		lines.push_back(IO::formatString("#WAVEOFFSET %g", sus.metadata.waveOffset));
-		lines.push_back("");
-    for (const auto& request : sus.metadata.requests)
-      lines.push_back(IO::formatString("#REQUEST \"%s\"", request.c_str()));
-		lines.push_back("");
+		writeLine(IO::formatString("#WAVEOFFSET %g", sus.metadata.waveOffset));
+		writeLine("");
+		for (const auto& request : sus.metadata.requests)
+			writeLine(IO::formatString("#REQUEST \"%s\"", request.c_str()));
+		writeLine("");
 
 		// Do we really need a copy of each here?
 		auto barLengths = sus.barlengths;
@@ -250,25 +281,20 @@ namespace MikuMikuWorld
 		std::stable_sort(guides.begin(), guides.end(),
 			[](const auto& a, const auto& b) { return a[0].tick < b[0].tick; });
 
-		measuresMap.clear();
+		measureCells.clear();
+		hiSpeedGroups.clear();
+		hiSpeedGroupIndices.clear();
 		barLengthTicks.clear();
-		int baseMeasure = 0;
+		baseMeasure = 0;
 
 		// Write time signatures
 		for (const auto& barLength : barLengths)
 		{
-			int base = (barLength.bar / 1000) * 1000;
-			int offset = barLength.bar % 1000;
-			if (base != baseMeasure)
-			{
-				lines.push_back("#MEASUREBS " + std::to_string(base));
-				baseMeasure = base;
-			}
-
-			lines.push_back(formatString("#%03d02: %g", offset, barLength.length));
+			setBaseMeasure(barLength.bar, output);
+			writeLine(formatString("#%03d02: %g", barLength.bar % 1000, barLength.length));
 		}
 
-		lines.push_back("");
+		writeLine("");
 
 		int totalTicks = 0;
 		for (int i = 0; i < barLengths.size(); ++i)
@@ -295,7 +321,7 @@ namespace MikuMikuWorld
 			if (bpmIdentifiers.find(bpm.bpm) == bpmIdentifiers.end())
 			{
 				bpmIdentifiers[bpm.bpm] = identifier;
-				lines.push_back(formatString("#BPM%s: %g", identifier.c_str(), bpm.bpm));
+				writeLine(formatString("#BPM%s: %g", identifier.c_str(), bpm.bpm));
 			}
 		}
 
@@ -319,13 +345,7 @@ namespace MikuMikuWorld
 
 		for (const auto& [measure, bpms] : measuresBpms)
 		{
-			int base = (measure / 1000) * 1000;
-			int offset = measure % 1000;
-			if (base != baseMeasure)
-			{
-				lines.push_back("#MEASUREBS " + std::to_string(base));
-				baseMeasure = base;
-			}
+			setBaseMeasure(measure, output);
 
 			int measureTicks = getTicksFromMeasure(measure);
 			int ticksPerMeasure = getTicksFromMeasure(measure + 1) - measureTicks;
@@ -345,73 +365,63 @@ namespace MikuMikuWorld
 				data[index + 1] = identifier[1];
 			}
 
-			lines.push_back(formatString("#%03d08: %s", offset, data.c_str()));
+			writeLine(formatString("#%03d08: %s", measure % 1000, data.c_str()));
 		}
 
-		lines.push_back("");
+		writeLine("");
 
 		for (int i = 0; i < sus.hiSpeedGroups.size(); ++i)
 		{
-      std::string speedLine = "\"";
-      for (int j = 0; j < sus.hiSpeedGroups[i].hiSpeeds.size(); ++j)
-      {
-        const auto& hiSpeed = sus.hiSpeedGroups[i].hiSpeeds[j];
-        int measure = getMeasureFromTicks(hiSpeed.tick);
-        int offsetTicks = hiSpeed.tick - getTicksFromMeasure(measure);
-        float speed = hiSpeed.speed;
-
-        speedLine.append(formatString("%d'%d:%g", measure, offsetTicks, speed));
-
-        if (i < sus.hiSpeedGroups.size() - 1 || j < sus.hiSpeedGroups[i].hiSpeeds.size() - 1)
-          speedLine.append(", ");
-      }
-      speedLine.append("\"");
-
-      char buff1[10];
-      std::string info = tostringBaseN(buff1, i, 36);
-      if (info.size() < 2)
-        info = "0" + info;
-
-      lines.push_back(formatString("#TIL%s: %s", info.c_str(), speedLine.c_str()));
+			std::string speedLine = "\"";
+			for (int j = 0; j < sus.hiSpeedGroups[i].hiSpeeds.size(); ++j)
+			{
+				const auto& hiSpeed = sus.hiSpeedGroups[i].hiSpeeds[j];
+				int measure = getMeasureFromTicks(hiSpeed.tick);
+				int offsetTicks = hiSpeed.tick - getTicksFromMeasure(measure);
+				float speed = hiSpeed.speed;
+
+				speedLine.append(formatString("%d'%d:%g", measure, offsetTicks, speed));
+
+				if (i < sus.hiSpeedGroups.size() - 1 || j < sus.hiSpeedGroups[i].hiSpeeds.size() - 1)
+					speedLine.append(", ");
+			}
+			speedLine.append("\"");
+
+			char buff1[10];
+			std::string info = tostringBaseN(buff1, i, 36);
+			if (info.size() < 2)
+				info = "0" + info;
+
+			writeLine(formatString("#TIL%s: %s", info.c_str(), speedLine.c_str()));
 		}
 
-		lines.push_back("#MEASUREHS 00");
-		lines.push_back("");
+		writeLine("#MEASUREHS 00");
+		writeLine("");
 
 		// Write short notes
-		measuresMap.clear();
 		for (const auto& tap : taps)
-			appendNoteData(tap, "1", "-1");
+			appendNoteData(tap, '1');
 
-		std::vector<std::string> tapLines = getNoteLines(baseMeasure);
-		lines.insert(lines.end(), tapLines.begin(), tapLines.end());
+		writeNoteLines(output);
 
 		// Write directional notes
-		measuresMap.clear();
 		for (const auto& directional : directionals)
-			appendNoteData(directional, "5", "-1");
+			appendNoteData(directional, '5');
 
-		std::vector<std::string> directionalLines = getNoteLines(baseMeasure);
-		lines.insert(lines.end(), directionalLines.begin(), directionalLines.end());
+		writeNoteLines(output);
 
 		// Write slide notes
-		measuresMap.clear();
-		appendSlideData(slides, "3");
-
-		std::vector<std::string> slideLines = getNoteLines(baseMeasure);
-		lines.insert(lines.end(), slideLines.begin(), slideLines.end());
+		appendSlideData(slides, '3');
+		writeNoteLines(output);
 
 		// Write guide notes
-		measuresMap.clear();
-		appendSlideData(guides, "9");
-
-		std::vector<std::string> guideLines = getNoteLines(baseMeasure);
-		lines.insert(lines.end(), guideLines.begin(), guideLines.end());
+		appendSlideData(guides, '9');
+		writeNoteLines(output);
 
 		std::wstring wFilename = mbToWideStr(filename);
 		File susfile(wFilename, L"w");
 
-		susfile.writeAllLines(lines);
+		susfile.write(output);
 		susfile.flush();
 		susfile.close();
 	}
@@ -1,6 +1,7 @@
 #pragma once
+#include <array>
+#include <cstdint>
 #include <string>
-#include <map>
 #include <vector>
 #include <unordered_map>
 
@@ -24,23 +25,19 @@ namespace MikuMikuWorld
 
 	struct SUS;
 
-	struct NoteMap
+	// A note waiting to be written, bucketed by the measure it is in
+	struct NoteCell
 	{
-		struct RawData
-		{
-			int tick;
-			std::string data;
-      std::string hiSpeedGroup;
-		};
-
-		std::vector<RawData> data;
+		int tick;
 		int ticksPerMeasure;
-	};
+		int hiSpeedGroup;
 
-	struct MeasureMap
-	{
-		int measure;
-		std::map<std::string, NoteMap> notesMap;
+		// Sort key of the line the cell goes on, set once the group ranks are known
+		uint64_t line;
+
+		// The header after the measure, null terminated, and the two characters of the cell
+		std::array<char, 4> info;
+		std::array<char, 2> data;
 	};
 
 	struct BarLengthTicks
@@ -53,19 +50,25 @@ namespace MikuMikuWorld
 	{
 	private:
 		int ticksPerBeat;
-		std::map<int, MeasureMap> measuresMap;
 		std::vector<BarLengthTicks> barLengthTicks;
 
+		// Cells of the notes being written indexed by measure
+		std::vector<std::vector<NoteCell>> measureCells;
+		std::vector<std::string> hiSpeedGroups;
+		std::unordered_map<std::string, int> hiSpeedGroupIndices;
+		int baseMeasure;
+
+		const BarLengthTicks* findBarLength(int ticks) const;
 		int getMeasureFromTicks(int ticks);
 		int getTicksFromMeasure(int measure);
-		void appendSlideData(const SUSNoteStream& slides, const std::string& infoPrefix);
-		std::vector<std::string> getNoteLines(int baseMeasure);
+		void setBaseMeasure(int measure, std::string& output);
+		void appendSlideData(const SUSNoteStream& slides, char infoPrefix);
+		void writeNoteLines(std::string& output);
 
 	public:
 		SusExporter();
 
-		void appendData(int tick, std::string info, std::string data, std::string hiSpeedGroup);
-		void appendNoteData(const SUSNote& note, const std::string infoPrefix, const std::string channel);
+		void appendNoteData(const SUSNote& note, char infoPrefix, int channel = -1);
 		void dump(const SUS& sus, const std::string& filename, std::string comment = "");
 	};
 }
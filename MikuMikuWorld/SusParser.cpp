@@ -1,51 +1,116 @@
 #include "SusParser.h"
 #include "File.h"
 #include "IO.h"
+#include <algorithm>
+#include <cstdlib>
+#include <future>
+#include <stdexcept>
+#include <thread>
 
 using namespace IO;
 
 namespace MikuMikuWorld
 {
-	SusParser::SusParser() : ticksPerBeat{ 480 }, measureOffset{ 0 }, waveOffset{ 0 } {}
+	// Charts with fewer note lines than this are decoded on the calling thread
+	constexpr size_t minNoteChunkLines = 2048;
 
-	bool SusParser::isCommand(const std::string& line)
+	static std::string_view trimView(std::string_view value)
+	{
+		size_t start = value.find_first_not_of(' ');
+		if (start == std::string_view::npos)
+			return {};
+
+		return value.substr(start, value.find_last_not_of(' ') - start + 1);
+	}
+
+	// Values are views into the file buffer so they are copied to the stack to terminate them
+	static int parseInt(std::string_view value)
+	{
+		char buffer[32]{};
+		value.copy(buffer, std::min(value.size(), sizeof(buffer) - 1));
+		return atoi(buffer);
+	}
+
+	static float parseFloat(std::string_view value)
+	{
+		char buffer[32]{};
+		value.copy(buffer, std::min(value.size(), sizeof(buffer) - 1));
+		return atof(buffer);
+	}
+
+	static int parseBase36(char c)
+	{
+		if (c >= '0' && c <= '9')
+			return c - '0';
+		if (c >= 'a' && c <= 'z')
+			return c - 'a' + 10;
+		if (c >= 'A' && c <= 'Z')
+			return c - 'A' + 10;
+
+		throw std::invalid_argument("Invalid SUS note data.");
+	}
+
+	// Taps, slides, directionals and guides. Other note channels are ignored
+	static bool isNoteLine(std::string_view header)
+	{
+		return (header.size() == 5 && (header[3] == '1' || header[3] == '5')) ||
+		       (header.size() == 6 && (header[3] == '3' || header[3] == '9'));
+	}
+
+	SusParser::SusParser()
+	    : ticksPerBeat{ 480 }, measureOffset{ 0 }, laneOffset{ 0 }, sideLane{ false },
+	      waveOffset{ 0 }
+	{
+	}
+
+	bool SusParser::isCommand(std::string_view line)
 	{
 		if (isDigit(line.substr(1, 1)))
 			return false;
 
 		// Test for text value commands
-		if (line.find_first_of('"') != std::string::npos)
+		if (line.find_first_of('"') != std::string_view::npos)
 		{
-			std::vector<std::string> lineSplit = split(line, " ");
-			if (lineSplit.size() < 2)
+			size_t keyEnd = line.find_first_of(' ');
+			if (keyEnd == std::string_view::npos || keyEnd == line.size() - 1)
 				return false;
 
-			if (lineSplit[0].find_first_of(':') != std::string::npos)
+			if (line.substr(0, keyEnd).find_first_of(':') != std::string_view::npos)
 				return false;
 
-			int firstQuote = line.find_first_of('"');
-			int lastQuote = line.find_last_of('"');
-			return firstQuote != lastQuote && lastQuote != std::string::npos;
+			return line.find_first_of('"') != line.find_last_of('"');
 		}
 
-		return line.find_first_of(':') == std::string::npos;
+		return line.find_first_of(':') == std::string_view::npos;
 	}
 
-	int SusParser::toTicks(int measure, int i, int total)
+	int SusParser::toTicks(int measure, int i, int total) const
 	{
+#ifdef SUS_PARSER_LINEAR_BAR_LOOKUP
+		// The previous lookup, only built by the benchmark to compare against
 		int bIndex = 0;
 		int accBarTicks = 0;
-		for (int i = 0; i < bars.size(); ++i)
+		for (int b = 0; b < bars.size(); ++b)
 		{
-			if (bars[i].measure > measure)
+			if (bars[b].measure > measure)
 				break;
 
-			bIndex = i;
-			accBarTicks += bars[i].ticks;
+			bIndex = b;
+			accBarTicks += bars[b].ticks;
 		}
 
 		return accBarTicks + ((measure - bars[bIndex].measure) * bars[bIndex].ticksPerMeasure) +
 		       ((i * bars[bIndex].ticksPerMeasure) / total);
+#else
+		// The last bar starting at or before measure. Earlier measures use the first bar
+		auto next = std::upper_bound(bars.begin(), bars.end(), measure,
+		                             [](int measure, const Bar& bar) { return measure < bar.measure; });
+		const Bar& current = next == bars.begin() ? bars.front() : *std::prev(next);
+		int accBarTicks = next == bars.begin() ? 0 : current.ticks;
+
+		return accBarTicks + ((measure - current.measure) * current.ticksPerMeasure) +
+		       ((i * current.ticksPerMeasure) / total);
+#endif
 	}
 
 	SUSNoteStream SusParser::toSlides(const std::vector<SUSNote>& stream)
@@ -78,25 +143,37 @@ namespace MikuMikuWorld
 		return slides;
 	}
 
-	std::vector<SUSNote> SusParser::toNotes(const std::string& header, const std::string& data,
-	                                        int measureBase)
+	void SusParser::appendNotes(const SusLineData& line, std::vector<SUSNote>& notes) const
 	{
-		std::vector<SUSNote> notes;
-		int measure = measureBase + std::stoul(header.substr(0, 3).c_str(), nullptr, 10);
-		for (int i = 0; i < data.size(); i += 2)
+		const std::string_view data = line.data;
+		int measure = line.measureOffset + parseInt(line.header.substr(0, 3));
+		int lane = parseBase36(line.header[4]) + laneOffset;
+		for (size_t i = 0; i + 1 < data.size(); i += 2)
 		{
 			// no data
-			if (data.substr(i, 2) == "00")
+			if (data[i] == '0' && data[i + 1] == '0')
 				continue;
 
-			notes.push_back(SUSNote{ toTicks(measure, i, data.size()),
-			                         (int)std::stoul(header.substr(4, 1), nullptr, 36) + laneOffset,
-			                         (int)std::stoul(data.substr(i + 1, 1), nullptr, 36),
-			                         (int)std::stoul(data.substr(i, 1), nullptr, 36),
-			                         currentHiSpeedGroup });
+			notes.push_back(SUSNote{ toTicks(measure, i, data.size()), lane,
+			                         parseBase36(data[i + 1]), parseBase36(data[i]),
+			                         std::string(line.hiSpeedGroup) });
 		}
+	}
 
-		return notes;
+	SusNoteChunk SusParser::decodeNoteLines(const std::vector<SusLineData>& lines, size_t begin,
+	                                        size_t end) const
+	{
+		SusNoteChunk chunk;
+		chunk.lineEnds.reserve(end - begin);
+		for (size_t i = begin; i < end; ++i)
+		{
+			if (isNoteLine(lines[i].header))
+				appendNotes(lines[i], chunk.notes);
+
+			chunk.lineEnds.push_back(chunk.notes.size());
+		}
+
+		return chunk;
 	}
 
 	void SusParser::processCommand(std::string& line)
@@ -144,14 +221,12 @@ namespace MikuMikuWorld
 	{
 		std::wstring wFilename = mbToWideStr(filename);
 
-		File susFile(wFilename, L"r");
-		auto lines = susFile.readAllLines();
+		// The stream is only at its end here if the file could not be opened
+		File susFile(wFilename, L"rb");
+		std::string text = susFile.isEndofFile() ? "" : susFile.readAllText();
 		susFile.close();
 
-		currentHiSpeedGroup = "00";
-
-		std::unordered_map<int, int> measureOffsets;
-		std::unordered_map<int, std::string> hiSpeedGroupChanges;
+		std::string_view currentHiSpeedGroup = "00";
 
 		std::vector<SusLineData> noteLines;
 		std::vector<SusLineData> bpmLines;
@@ -160,66 +235,67 @@ namespace MikuMikuWorld
 		bpmDefinitions.clear();
 		measureOffset = 0;
 
-		for (int i = 0; i < lines.size(); ++i)
+		std::string_view remaining = text;
+		for (int i = 0; !remaining.empty(); ++i)
 		{
-			std::string line = trim(lines[i]);
+			size_t lineEnd = remaining.find_first_of('\n');
+			std::string_view line = remaining.substr(0, lineEnd);
+			remaining.remove_prefix(lineEnd == std::string_view::npos ? remaining.size()
+			                                                          : lineEnd + 1);
+
+			if (!line.empty() && line.back() == '\r')
+				line.remove_suffix(1);
+
+			line = trimView(line);
 			if (!startsWith(line, "#"))
 				continue;
 
-			if (line.substr(0, 9) == "#HISPEED ")
+			if (startsWith(line, "#HISPEED "))
 			{
-				int keyPos = line.find_first_of(' ');
-				if (keyPos == std::string::npos)
-					continue;
-
-				std::string value = line.substr(keyPos + 1);
-				hiSpeedGroupChanges.insert_or_assign((int)noteLines.size(), trim(value));
+				currentHiSpeedGroup = trimView(line.substr(line.find_first_of(' ') + 1));
 				continue;
 			}
-			else if (line.substr(0, 12) == "#MEASUREBS ")
+			else if (startsWith(line, "#MEASUREBS "))
 			{
-				int keyPos = line.find_first_of(' ');
-				if (keyPos == std::string::npos)
-					continue;
-
-				std::string value = line.substr(keyPos + 1);
-				measureOffsets.insert_or_assign((int)noteLines.size(), atoi(value.c_str()));
+				measureOffset = parseInt(line.substr(line.find_first_of(' ') + 1));
 				continue;
 			}
 			else if (isCommand(line))
 			{
-				processCommand(line);
+				std::string command(line);
+				processCommand(command);
 			}
 			else
 			{
-				auto l = split(line, ":");
-				if (l.size() < 2) // no ':' found
+				size_t separator = line.find_first_of(':');
+				if (separator == std::string_view::npos || separator == line.size() - 1)
 					continue;
 
-				std::string header = trim(l[0]).substr(1);
-				std::string data = l.size() > 1 ? trim(l[1]) : "";
+				std::string_view header = trimView(line.substr(0, separator)).substr(1);
+				std::string_view data = line.substr(separator + 1);
+				data = trimView(data.substr(0, data.find_first_of(':')));
 
-				if (header.size() == 5 && header.substr(header.size() - 2) == "02" &&
-				    isDigit(header))
+				SusLineData lineData{ i, measureOffset, line, header, data, currentHiSpeedGroup };
+				if (header.size() == 5 && endsWith(header, "02") && isDigit(header))
 				{
-					barLengths.push_back({ measureOffset + atoi(header.substr(0, 3).c_str()),
-					                       (float)atof((data.c_str())) });
+					barLengths.push_back(
+					    { measureOffset + parseInt(header.substr(0, 3)), parseFloat(data) });
 				}
 				else if (header.size() == 5 && startsWith(header, "BPM"))
 				{
-					bpmDefinitions[header.substr(3)] = atof(data.c_str());
+					bpmDefinitions[std::string(header.substr(3))] = parseFloat(data);
 				}
-				else if (header.size() == 5 && header.substr(0, 3) == "TIL")
+				else if (header.size() == 5 && startsWith(header, "TIL"))
 				{
-					hiSpeedLines.push_back({ i, measureOffset, line });
+					hiSpeedLines.push_back(lineData);
 				}
-				else if (header.size() == 5 && header.substr(header.size() - 2, 2) == "08")
+				else if (header.size() == 5 && endsWith(header, "08"))
 				{
-					bpmLines.push_back({ i, measureOffset, line });
+					bpmLines.push_back(lineData);
 				}
 				else if (header.size() == 5 || header.size() == 6)
 				{
-					noteLines.push_back({ i, measureOffset, line });
+					noteLines.push_back(lineData);
 				}
 			}
 		}
@@ -244,29 +320,30 @@ namespace MikuMikuWorld
 		std::sort(bars.begin(), bars.end(),
 		          [](const Bar& b1, const Bar& b2) { return b1.measure < b2.measure; });
 
+#ifndef SUS_PARSER_LINEAR_BAR_LOOKUP
+		// Accumulate the ticks so each bar holds the tick it starts at for toTicks
+		for (int i = 1; i < bars.size(); ++i)
+			bars[i].ticks += bars[i - 1].ticks;
+#endif
+
 		// Process BPM changes
 		std::vector<BPM> bpms;
-		for (auto& line : bpmLines)
+		for (const auto& line : bpmLines)
 		{
-			auto l = split(line.line, ":");
-			if (l.size() < 2) // no ':' found
-				continue;
-
-			std::string header = trim(l[0]).substr(1);
-			std::string data = l.size() > 1 ? trim(l[1]) : "";
-
-			for (int i = 0; i < data.size(); i += 2)
+			const std::string_view data = line.data;
+			int measure = line.measureOffset + parseInt(line.header.substr(0, 3));
+			for (size_t i = 0; i < data.size(); i += 2)
 			{
-				std::string subData = data.substr(i, 2);
+				std::string_view subData = data.substr(i, 2);
 				if (subData == "00")
 					continue;
 
-				int tick =
-				    toTicks(line.measureOffset + atoi(header.substr(0, 3).c_str()), i, data.size());
+				int tick = toTicks(measure, i, data.size());
 				float bpm = 120;
 
-				if (bpmDefinitions.find(subData) != bpmDefinitions.end())
-					bpm = bpmDefinitions[subData];
+				auto definition = bpmDefinitions.find(std::string(subData));
+				if (definition != bpmDefinitions.end())
+					bpm = definition->second;
 
 				bpms.push_back({ tick, bpm });
 			}
@@ -276,43 +353,42 @@ namespace MikuMikuWorld
 
 		// process hi-speed changes
 		std::vector<HiSpeedGroup> hiSpeedGroups;
-		for (auto& line : hiSpeedLines)
+		for (const auto& line : hiSpeedLines)
 		{
-			auto l = split(line.line, ":");
-			if (l.size() < 2) // no ':' found
-				continue;
-
-			std::string name = trim(l[0]).substr(4);
-			std::string lineData = line.line.substr(line.line.find_first_of(':') + 1);
-			int firstQuote = lineData.find_first_of('"') + 1;
-			int lastQuote = lineData.find_last_of('"');
+			std::string_view lineData = line.line.substr(line.line.find_first_of(':') + 1);
+			size_t firstQuote = lineData.find_first_of('"') + 1;
+			size_t lastQuote = lineData.find_last_of('"');
 
 			HiSpeedGroup group;
-			group.name = name;
+			group.name = line.header.substr(3);
+
+			if (firstQuote == 0 || lastQuote < firstQuote)
+				continue;
 
 			lineData = lineData.substr(firstQuote, lastQuote - firstQuote);
 			if (!lineData.size())
 				continue;
 
-			std::vector<std::string> speedChanges = split(lineData, ",");
-			for (const auto& change : speedChanges)
+			while (!lineData.empty())
 			{
-				int measure = 0;
+				size_t changeEnd = lineData.find_first_of(',');
+				std::string_view change = lineData.substr(0, changeEnd);
+				lineData.remove_prefix(changeEnd == std::string_view::npos ? lineData.size()
+				                                                           : changeEnd + 1);
+
 				int tick = 0;
 				float speed = 1.0f;
 
-				int i1 = 0;
-				int i2 = 0;
-
-				i2 = change.find_first_of("'", i1);
-				measure = atoi(change.substr(i1, i2 - i1).c_str());
-
-				i1 = ++i2;
-				i2 = change.find_first_of(":", i2);
-				tick = atoi(change.substr(i1, i2 - i1).c_str());
-
-				i1 = ++i2;
-				speed = atof(change.substr(i1).c_str());
+				size_t measureEnd = change.find_first_of('\'');
+				int measure = parseInt(change.substr(0, measureEnd));
+				if (measureEnd != std::string_view::npos)
+				{
+					change.remove_prefix(measureEnd + 1);
+					size_t tickEnd = change.find_first_of(':');
+					tick = parseInt(change.substr(0, tickEnd));
+					if (tickEnd != std::string_view::npos)
+						speed = parseFloat(change.substr(tickEnd + 1));
+				}
 
 				int measureTicks = toTicks(measure, 0, 1);
 				group.hiSpeeds.push_back({ measureTicks + tick, speed });
@@ -323,50 +399,50 @@ namespace MikuMikuWorld
 			hiSpeedGroups.push_back(group);
 		}
 
-		// Process notes
+		// Note lines only depend on the bars and lane offset, so long charts decode them in
+		// chunks on separate threads
+		size_t chunkCount = std::clamp<size_t>(noteLines.size() / minNoteChunkLines, 1,
+		                                       std::max(1u, std::thread::hardware_concurrency()));
+		const std::launch policy = chunkCount > 1 ? std::launch::async : std::launch::deferred;
+
+		std::vector<std::future<SusNoteChunk>> chunkTasks;
+		chunkTasks.reserve(chunkCount);
+		for (size_t i = 0; i < chunkCount; ++i)
+		{
+			size_t begin = noteLines.size() * i / chunkCount;
+			size_t end = noteLines.size() * (i + 1) / chunkCount;
+			chunkTasks.push_back(std::async(policy, &SusParser::decodeNoteLines, this,
+			                                std::cref(noteLines), begin, end));
+		}
+
+		// Merged line by line in file order so the result matches a sequential parse
 		std::vector<SUSNote> taps;
 		std::vector<SUSNote> directionals;
 		std::unordered_map<int, std::vector<SUSNote>> slideStreams;
 		std::unordered_map<int, std::vector<SUSNote>> guideStreams;
-		for (int i = 0; i < noteLines.size(); i++)
+		size_t lineIndex = 0;
+		for (auto& task : chunkTasks)
 		{
-			if (measureOffsets.find(i) != measureOffsets.end())
-				measureOffset = measureOffsets[i];
-			if (hiSpeedGroupChanges.find(i) != hiSpeedGroupChanges.end())
-				currentHiSpeedGroup = hiSpeedGroupChanges[i];
-			auto line = noteLines[i];
-			auto l = split(line.line, ":");
-			if (l.size() < 2) // no ':' found
-				continue;
-
-			std::string header = trim(l[0]).substr(1);
-			std::string data = l.size() > 1 ? trim(l[1]) : "";
-
-			if (header.size() == 5 && header[3] == '1')
+			SusNoteChunk chunk = task.get();
+			auto notesBegin = std::make_move_iterator(chunk.notes.begin());
+			size_t lineBegin = 0;
+			for (size_t lineEnd : chunk.lineEnds)
 			{
-				std::vector<SUSNote> appendNotes = toNotes(header, data, line.measureOffset);
-				taps.insert(taps.end(), appendNotes.begin(), appendNotes.end());
-			}
-			else if (header.size() == 6 && header[3] == '3')
-			{
-				int channel = std::stoul(header.substr(5, 1), nullptr, 36);
-
-				std::vector<SUSNote> appendNotes = toNotes(header, data, line.measureOffset);
-				slideStreams[channel].insert(slideStreams[channel].end(), appendNotes.begin(),
-				                             appendNotes.end());
-			}
-			else if (header.size() == 5 && header[3] == '5')
-			{
-				std::vector<SUSNote> appendNotes = toNotes(header, data, line.measureOffset);
-				directionals.insert(directionals.end(), appendNotes.begin(), appendNotes.end());
-			}
-			else if (header.size() == 6 && header[3] == '9')
-			{
-				int channel = std::stoul(header.substr(5, 1), nullptr, 36);
-
-				std::vector<SUSNote> appendNotes = toNotes(header, data, line.measureOffset);
-				guideStreams[channel].insert(guideStreams[channel].end(), appendNotes.begin(),
-				                             appendNotes.end());
+				const std::string_view header = noteLines[lineIndex++].header;
+				std::vector<SUSNote>* target = nullptr;
+				if (header.size() == 5 && header[3] == '1')
+					target = &taps;
+				else if (header.size() == 6 && header[3] == '3')
+					target = &slideStreams[parseBase36(header[5])];
+				else if (header.size() == 5 && header[3] == '5')
+					target = &directionals;
+				else if (header.size() == 6 && header[3] == '9')
+					target = &guideStreams[parseBase36(header[5])];
+
+				if (target)
+					target->insert(target->end(), notesBegin + lineBegin, notesBegin + lineEnd);
+
+				lineBegin = lineEnd;
 			}
 		}
 
@@ -2,14 +2,26 @@
 #include "SUS.h"
 #include <regex>
 #include <string>
+#include <string_view>
 
 namespace MikuMikuWorld
 {
+	// Views into the file buffer, valid only while parsing
 	struct SusLineData
 	{
 		int lineIndex;
 		int measureOffset;
-		std::string line;
+		std::string_view line;
+		std::string_view header;
+		std::string_view data;
+		std::string_view hiSpeedGroup;
+	};
+
+	// Notes decoded from a run of note lines. lineEnds holds the end of each line's notes
+	struct SusNoteChunk
+	{
+		std::vector<SUSNote> notes;
+		std::vector<size_t> lineEnds;
 	};
 
 	struct SusLineArgs
@@ -32,13 +44,14 @@ namespace MikuMikuWorld
 		std::unordered_map<std::string, float> bpmDefinitions;
 		std::vector<Bar> bars;
 
-		std::string currentHiSpeedGroup;
-
-		bool isCommand(const std::string& line);
-		int toTicks(int measure, int i, int total);
+		bool isCommand(std::string_view line);
+		int toTicks(int measure, int i, int total) const;
 		SUSNoteStream toSlides(const std::vector<SUSNote>& stream);
-		std::vector<SUSNote> toNotes(const std::string& header, const std::string& data,
-		                             int measureBase);
+		void appendNotes(const SusLineData& line, std::vector<SUSNote>& notes) const;
+
+		// Only reads the parser state so chunks can be decoded in parallel
+		SusNoteChunk decodeNoteLines(const std::vector<SusLineData>& lines, size_t begin,
+		                             size_t end) const;
 
 	  public:
 		SusParser();
@@ -2,6 +2,7 @@
 #include "Constants.h"
 #include "Score.h"
 #include <algorithm>
+#include <cmath>
 
 namespace MikuMikuWorld
 {
@@ -24,135 +25,105 @@ namespace MikuMikuWorld
 		return secs / (60.0f / bpm / (float)beatTicks);
 	}
 
-	float accumulateDuration(int tick, int beatTicks, const std::vector<Tempo>& bpms)
+	void TempoMap::rebuild(const std::vector<Tempo>& tempos, int _beatTicks)
 	{
-		float total = 0;
-		int accTicks = 0;
-		int lastBPM = 0;
+		beatTicks = _beatTicks;
+		segments.clear();
+		segments.reserve(tempos.size());
 
-		for (int i = 0; i < bpms.size() - 1; ++i)
+		double seconds = 0;
+		for (int i = 0; i < tempos.size(); ++i)
 		{
-			lastBPM = i;
-			int ticks = bpms[i + 1].tick - bpms[i].tick;
-			if (accTicks + ticks >= tick)
-				break;
-
-			accTicks += ticks;
-			total += ticksToSec(bpms[i + 1].tick - bpms[i].tick, beatTicks, bpms[i].bpm);
-			lastBPM = i + 1;
-		}
+			if (i > 0)
+				seconds += (tempos[i].tick - tempos[i - 1].tick) * 60.0 /
+				           ((double)tempos[i - 1].bpm * beatTicks);
 
-		total += ticksToSec(tick - bpms[lastBPM].tick, beatTicks, bpms[lastBPM].bpm);
+			segments.push_back({ tempos[i].tick, tempos[i].bpm, seconds });
+		}
 
-		return total;
+		dirty = false;
 	}
 
-	int accumulateTicks(float sec, int beatTicks, const std::vector<Tempo>& bpms)
+	double TempoMap::ticksToSeconds(int tick) const
 	{
-		int total = 0;
-		float accSecs = 0;
-		int lastBPM = 0;
+		if (segments.empty())
+			return 0;
 
-		for (int i = 0; i < bpms.size() - 1; ++i)
-		{
-			lastBPM = i;
-			float seconds = ticksToSec(bpms[i + 1].tick - bpms[i].tick, beatTicks, bpms[i].bpm);
-			if (accSecs + seconds >= sec)
-				break;
+		// The last tempo change before the tick
+		auto it = std::lower_bound(segments.begin(), segments.end(), tick,
+		                           [](const TempoSegment& s, int t) { return s.tick < t; });
+		const TempoSegment& segment = it == segments.begin() ? *it : *std::prev(it);
 
-			total += secsToTicks(seconds, beatTicks, bpms[i].bpm);
-			accSecs += seconds;
+		return segment.seconds + (tick - segment.tick) * 60.0 / (segment.bpm * beatTicks);
+	}
 
-			// last tempo is included
-			lastBPM = i + 1;
-		}
+	int TempoMap::secondsToTicks(double seconds) const
+	{
+		if (segments.empty())
+			return 0;
 
-		total += secsToTicks(sec - accSecs, beatTicks, bpms[lastBPM].bpm);
+		auto it = std::lower_bound(segments.begin(), segments.end(), seconds,
+		                           [](const TempoSegment& s, double t) { return s.seconds < t; });
+		const TempoSegment& segment = it == segments.begin() ? *it : *std::prev(it);
 
-		return total;
+		// Nudge away from zero so the time of a tick converts back to the same tick
+		double ticks = (seconds - segment.seconds) * segment.bpm * beatTicks / 60.0;
+		return segment.tick + (int)(ticks + std::copysign(1e-6, ticks));
 	}
 
-	int accumulateMeasures(int tick, int beatTicks, const std::map<int, TimeSignature>& ts)
+	void MeasureTable::rebuild(const std::map<int, TimeSignature>& ts, int beatTicks)
 	{
-		int accTicks = 0;
-		int total = 0;
-		auto lastSignature = ts.begin();
+		segments.clear();
+		segments.reserve(ts.size());
 
-		for (auto t = ts.begin(); t != std::prev(ts.end()); t = std::next(t))
+		int tick = 0;
+		for (auto it = ts.begin(); it != ts.end(); ++it)
 		{
-			lastSignature = t;
-			int ticksPerMeasure = beatsPerMeasure(t->second) * beatTicks;
-			int measures = std::next(t)->first - t->first;
-			int ticks = measures * ticksPerMeasure;
-
-			if (accTicks + ticks >= tick)
-				break;
-
-			total += measures;
-			accTicks += ticks;
-			lastSignature = std::next(t);
+			if (it != ts.begin())
+			{
+				const MeasureSegment& prev = segments.back();
+				tick += (it->first - prev.measure) * prev.ticksPerMeasure;
+			}
+
+			float exactTicksPerMeasure = beatsPerMeasure(it->second) * beatTicks;
+			segments.push_back({ it->first, it->first - ts.begin()->first, tick,
+			                     (int)exactTicksPerMeasure, exactTicksPerMeasure });
 		}
 
-		total += (tick - accTicks) / (beatsPerMeasure(lastSignature->second) * beatTicks);
-		return total;
+		dirty = false;
 	}
 
-	int measureToTicks(int measure, int beatTicks, const std::map<int, TimeSignature>& ts)
+	int MeasureTable::accumulateMeasures(int tick) const
 	{
-		int accMeasures = 0;
-		int total = 0;
-		auto lastSignature = ts.begin();
-
-		for (auto t = ts.begin(); t != std::prev(ts.end()); t = std::next(t))
-		{
-			lastSignature = t;
-			int ticksPerMeasure = beatsPerMeasure(t->second) * beatTicks;
-			int measures = std::next(t)->first - t->first;
-			int ticks = measures * ticksPerMeasure;
+		if (segments.empty())
+			return 0;
 
-			if (accMeasures + measures >= measure)
-				break;
+		// The last time signature starting before the tick
+		auto it = std::lower_bound(segments.begin(), segments.end(), tick,
+		                           [](const MeasureSegment& s, int t) { return s.tick < t; });
+		const MeasureSegment& segment = it == segments.begin() ? *it : *std::prev(it);
 
-			total += ticks;
-			accMeasures += measures;
-			lastSignature = std::next(t);
-		}
-
-		total +=
-		    (measure - lastSignature->first) * (beatsPerMeasure(lastSignature->second) * beatTicks);
-		return total;
+		return segment.measureOffset + (int)((tick - segment.tick) / segment.exactTicksPerMeasure);
 	}
 
-	int findTimeSignature(int measure, const std::map<int, TimeSignature>& ts)
+	int MeasureTable::measureToTicks(int measure) const
 	{
-		for (auto it = ts.rbegin(); it != ts.rend(); ++it)
-		{
-			if (it->second.measure <= measure)
-				return it->second.measure;
-		}
+		if (segments.empty())
+			return 0;
+
+		auto it = std::lower_bound(segments.begin(), segments.end(), measure,
+		                           [](const MeasureSegment& s, int m) { return s.measureOffset < m; });
+		const MeasureSegment& segment = it == segments.begin() ? *it : *std::prev(it);
 
-		return 0;
+		return segment.tick + (int)((measure - segment.measure) * segment.exactTicksPerMeasure);
 	}
 
-	int findHighSpeedChange(int tick, const std::unordered_map<int, HiSpeedChange>& hiSpeeds,
-	                        int selectedLayer)
+	int MeasureTable::findTimeSignature(int measure) const
 	{
-		std::vector<std::pair<int, HiSpeedChange>> currentLayersHiSpeeds;
-		for (auto& [i, h] : hiSpeeds)
-		{
-			if (selectedLayer != -1 && h.layer != selectedLayer)
-				continue;
-			currentLayersHiSpeeds.push_back(std::pair(i, h));
-		}
-		std::sort(currentLayersHiSpeeds.begin(), currentLayersHiSpeeds.end(),
-		          [](const auto& a, const auto& b) { return a.second.tick < b.second.tick; });
-		for (auto it = currentLayersHiSpeeds.rbegin(); it != currentLayersHiSpeeds.rend(); ++it)
-		{
-			if (it->second.tick <= tick)
-				return it->first;
-		}
+		auto it = std::upper_bound(segments.begin(), segments.end(), measure,
+		                           [](int m, const MeasureSegment& s) { return m < s.measure; });
 
-		return -1;
+		return it == segments.begin() ? 0 : std::prev(it)->measure;
 	}
 
 	const Tempo& getTempoAt(int tick, const std::vector<Tempo>& tempos)
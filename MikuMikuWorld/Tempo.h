@@ -6,8 +6,6 @@
 
 namespace MikuMikuWorld
 {
-	struct HiSpeedChange;
-
 	struct TimeSignature
 	{
 		int measure;
@@ -24,20 +22,71 @@ namespace MikuMikuWorld
 		Tempo(int tick, float bpm);
 	};
 
+	// Cumulative time at each tempo change for converting between ticks and seconds
+	class TempoMap
+	{
+	  private:
+		struct TempoSegment
+		{
+			int tick;
+			double bpm;
+			double seconds;
+		};
+
+		std::vector<TempoSegment> segments;
+		int beatTicks{};
+		bool dirty{ true };
+
+	  public:
+		inline void invalidate() { dirty = true; }
+		inline bool isValid(const std::vector<Tempo>& tempos) const
+		{
+			return !dirty && segments.size() == tempos.size();
+		}
+
+		void rebuild(const std::vector<Tempo>& tempos, int beatTicks);
+
+		double ticksToSeconds(int tick) const;
+		int secondsToTicks(double seconds) const;
+	};
+
+	// Cumulative ticks at each time signature change for converting between ticks and measures
+	class MeasureTable
+	{
+	  private:
+		struct MeasureSegment
+		{
+			int measure;
+			int measureOffset;
+			int tick;
+			int ticksPerMeasure;
+			float exactTicksPerMeasure;
+		};
+
+		std::vector<MeasureSegment> segments;
+		bool dirty{ true };
+
+	  public:
+		inline void invalidate() { dirty = true; }
+		inline bool isValid(const std::map<int, TimeSignature>& ts) const
+		{
+			return !dirty && segments.size() == ts.size();
+		}
+
+		void rebuild(const std::map<int, TimeSignature>& ts, int beatTicks);
+
+		int accumulateMeasures(int tick) const;
+		int measureToTicks(int measure) const;
+
+		// Measure of the time signature active at the given measure
+		int findTimeSignature(int measure) const;
+	};
+
 	int snapTick(int tick, int div);
 	float beatsPerMeasure(const TimeSignature& t);
 
 	float ticksToSec(int ticks, int beatTicks, float bpm);
 	int secsToTicks(float secs, int beatTicks, float bpm);
 
-	float accumulateDuration(int tick, int beatTicks, const std::vector<Tempo>& tempos);
-	int accumulateTicks(float sec, int beatTicks, const std::vector<Tempo>& tempos);
-
-	int accumulateMeasures(int ticks, int beatTicks, const std::map<int, TimeSignature>& ts);
-	int measureToTicks(int measure, int beatTicks, const std::map<int, TimeSignature>& ts);
-
 	const Tempo& getTempoAt(int tick, const std::vector<Tempo>& tempos);
-	int findTimeSignature(int measure, const std::map<int, TimeSignature>& ts);
-	int findHighSpeedChange(int tick, const std::unordered_map<int, HiSpeedChange>& hiSpeeds,
-	                        int selectedLayer);
 }
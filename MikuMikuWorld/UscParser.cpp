@@ -0,0 +1,570 @@
+#include "UscParser.h"
+#include "Constants.h"
+#include "File.h"
+#include "IO.h"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace MikuMikuWorld
+{
+	template <typename T>
+	struct UscName
+	{
+		std::string_view name;
+		T value;
+	};
+
+	// Names are looked up in a table indexed by a hash of their length and first and last
+	// characters. Every table is checked at compile time to give each of its names its own slot
+	template <typename T, size_t N>
+	class UscNameTable
+	{
+	  private:
+		static constexpr size_t slotCount = 64;
+		std::array<UscName<T>, slotCount> slots{};
+		bool perfect{ true };
+
+		static constexpr size_t hashName(std::string_view name)
+		{
+			if (name.empty())
+				return 0;
+
+			return (name.size() * 25 + static_cast<unsigned char>(name.front()) * 60 +
+			        static_cast<unsigned char>(name.back())) %
+			       slotCount;
+		}
+
+	  public:
+		constexpr UscNameTable(const std::array<UscName<T>, N>& names)
+		{
+			for (const UscName<T>& name : names)
+			{
+				UscName<T>& slot = slots[hashName(name.name)];
+				perfect = perfect && !name.name.empty() && slot.name.empty();
+				slot = name;
+			}
+		}
+
+		constexpr bool isPerfect() const { return perfect; }
+
+		T find(std::string_view name, T fallback) const
+		{
+			const UscName<T>& slot = slots[hashName(name)];
+			return !name.empty() && slot.name == name ? slot.value : fallback;
+		}
+	};
+
+	static constexpr UscNameTable<UscKey, 21> keyNames{ { {
+		{ "version", UscKey::Version },
+		{ "usc", UscKey::Usc },
+		{ "offset", UscKey::Offset },
+		{ "objects", UscKey::Objects },
+		{ "type", UscKey::Type },
+		{ "beat", UscKey::Beat },
+		{ "bpm", UscKey::Bpm },
+		{ "size", UscKey::Size },
+		{ "lane", UscKey::Lane },
+		{ "critical", UscKey::Critical },
+		{ "trace", UscKey::Trace },
+		{ "direction", UscKey::Direction },
+		{ "timeScaleGroup", UscKey::TimeScaleGroup },
+		{ "timeScale", UscKey::TimeScale },
+		{ "color", UscKey::Color },
+		{ "fade", UscKey::Fade },
+		{ "ease", UscKey::Ease },
+		{ "judgeType", UscKey::JudgeType },
+		{ "changes", UscKey::Changes },
+		{ "midpoints", UscKey::Midpoints },
+		{ "connections", UscKey::Connections },
+	} } };
+
+	static constexpr UscNameTable<UscObjectType, 6> objectTypeNames{ { {
+		{ "bpm", UscObjectType::Bpm },
+		{ "timeScaleGroup", UscObjectType::TimeScaleGroup },
+		{ "single", UscObjectType::Single },
+		{ "damage", UscObjectType::Damage },
+		{ "guide", UscObjectType::Guide },
+		{ "slide", UscObjectType::Slide },
+	} } };
+
+	static constexpr UscNameTable<UscStepType, 4> stepTypeNames{ { {
+		{ "start", UscStepType::Start },
+		{ "end", UscStepType::End },
+		{ "tick", UscStepType::Tick },
+		{ "attach", UscStepType::Attach },
+	} } };
+
+	static constexpr UscNameTable<EaseType, 5> easeTypeNames{ { {
+		{ "linear", EaseType::Linear },
+		{ "in", EaseType::EaseIn },
+		{ "out", EaseType::EaseOut },
+		{ "inout", EaseType::EaseInOut },
+		{ "outin", EaseType::EaseOutIn },
+	} } };
+
+	static constexpr UscNameTable<GuideColor, 8> guideColorNames{ { {
+		{ "neutral", GuideColor::Neutral },
+		{ "red", GuideColor::Red },
+		{ "green", GuideColor::Green },
+		{ "blue", GuideColor::Blue },
+		{ "yellow", GuideColor::Yellow },
+		{ "purple", GuideColor::Purple },
+		{ "cyan", GuideColor::Cyan },
+		{ "black", GuideColor::Black },
+	} } };
+
+	static constexpr UscNameTable<FadeType, 3> fadeTypeNames{ { {
+		{ "out", FadeType::Out },
+		{ "none", FadeType::None },
+		{ "in", FadeType::In },
+	} } };
+
+	static constexpr UscNameTable<FlickType, 3> flickTypeNames{ { {
+		{ "up", FlickType::Default },
+		{ "left", FlickType::Left },
+		{ "right", FlickType::Right },
+	} } };
+
+	static constexpr UscNameTable<UscJudgeType, 3> judgeTypeNames{ { {
+		{ "normal", UscJudgeType::Normal },
+		{ "trace", UscJudgeType::Trace },
+		{ "none", UscJudgeType::None },
+	} } };
+
+	static_assert(keyNames.isPerfect() && objectTypeNames.isPerfect() &&
+	                  stepTypeNames.isPerfect() && easeTypeNames.isPerfect() &&
+	                  guideColorNames.isPerfect() && fadeTypeNames.isPerfect() &&
+	                  flickTypeNames.isPerfect() && judgeTypeNames.isPerfect(),
+	              "USC names of the same table must not share a hash slot");
+
+	static void setPosition(Note& note, const UscValues& values)
+	{
+		note.tick = values.beat * TICKS_PER_BEAT;
+		note.lane = values.lane + 6 - values.size;
+		note.width = values.size * 2;
+		note.layer = values.layer;
+	}
+
+	UscValues* UscParser::currentValues()
+	{
+		if (contexts.empty())
+			return nullptr;
+
+		if (contexts.back() == Context::Object)
+			return &object.values;
+
+		if (contexts.back() == Context::Child)
+			return &object.children.back();
+
+		return nullptr;
+	}
+
+	bool UscParser::beginContainer(bool isArray)
+	{
+		// Everything outside the known structure is skipped along with its contents
+		Context context = Context::Skip;
+		if (contexts.empty())
+		{
+			context = isArray ? Context::Skip : Context::Root;
+		}
+		else
+		{
+			const Context parent = contexts.back();
+			if (parent == Context::Root && currentKey == UscKey::Usc && !isArray)
+			{
+				context = Context::Usc;
+			}
+			else if (parent == Context::Usc && currentKey == UscKey::Objects && isArray)
+			{
+				context = Context::Objects;
+			}
+			else if (parent == Context::Objects && !isArray)
+			{
+				object.values = {};
+				object.children.clear();
+				context = Context::Object;
+			}
+			else if (parent == Context::Object && isArray &&
+			         (currentKey == UscKey::Changes || currentKey == UscKey::Midpoints ||
+			          currentKey == UscKey::Connections))
+			{
+				context = Context::Children;
+			}
+			else if (parent == Context::Children && !isArray)
+			{
+				object.children.emplace_back();
+				context = Context::Child;
+			}
+		}
+
+		contexts.push_back(context);
+		currentKey = UscKey::Unknown;
+		return true;
+	}
+
+	bool UscParser::endContainer()
+	{
+		const Context context = contexts.back();
+		contexts.pop_back();
+
+		if (context == Context::Object)
+			addObject();
+
+		return true;
+	}
+
+	void UscParser::setNumber(double value)
+	{
+		const Context context = contexts.empty() ? Context::Skip : contexts.back();
+		if (context == Context::Root && currentKey == UscKey::Version)
+		{
+			version = value;
+		}
+		else if (context == Context::Usc && currentKey == UscKey::Offset)
+		{
+			score.metadata.musicOffset = static_cast<float>(value) * -1000.0f;
+		}
+		else if (UscValues* values = currentValues())
+		{
+			switch (currentKey)
+			{
+			case UscKey::Beat:
+				values->beat = value;
+				break;
+			case UscKey::Bpm:
+				values->bpm = value;
+				break;
+			case UscKey::Lane:
+				values->lane = value;
+				break;
+			case UscKey::Size:
+				values->size = value;
+				break;
+			case UscKey::TimeScale:
+				values->timeScale = value;
+				break;
+			case UscKey::TimeScaleGroup:
+				values->layer = value;
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	void UscParser::addObject()
+	{
+		const UscValues& values = object.values;
+		switch (values.objectType)
+		{
+		case UscObjectType::Bpm:
+			score.tempoChanges.push_back(
+			    Tempo{ static_cast<int>(values.beat * TICKS_PER_BEAT), values.bpm });
+			break;
+		case UscObjectType::TimeScaleGroup:
+		{
+			int index = score.layers.size();
+			score.layers.push_back(Layer{ IO::formatString("#%d", index) });
+			for (const UscValues& change : object.children)
+			{
+				int id = score.allocateHiSpeedID();
+				score.hiSpeedChanges[id] =
+				    HiSpeedChange{ id, static_cast<int>(change.beat * TICKS_PER_BEAT),
+					               change.timeScale, index };
+			}
+			break;
+		}
+		case UscObjectType::Single:
+		{
+			Note note(NoteType::Tap);
+			setPosition(note, values);
+			note.critical = values.critical;
+			note.friction = values.trace;
+			note.flick = values.flick;
+			note.ID = score.allocateNoteID();
+			score.notes[note.ID] = note;
+			break;
+		}
+		case UscObjectType::Damage:
+		{
+			Note note(NoteType::Damage);
+			setPosition(note, values);
+			note.ID = score.allocateNoteID();
+			score.notes[note.ID] = note;
+			break;
+		}
+		case UscObjectType::Guide:
+			addGuide();
+			break;
+		case UscObjectType::Slide:
+			addSlide();
+			break;
+		default:
+			break;
+		}
+	}
+
+	void UscParser::addGuide()
+	{
+		HoldNote hold;
+		hold.guideColor = object.values.color;
+		hold.fadeType = object.values.fade;
+
+		const std::vector<UscValues>& midpoints = object.children;
+		for (size_t i = 0; i < midpoints.size(); i++)
+		{
+			const UscValues& step = midpoints[i];
+			if (i == 0)
+			{
+				Note startNote(NoteType::Hold);
+				setPosition(startNote, step);
+				startNote.ID = score.allocateNoteID();
+				score.notes[startNote.ID] = startNote;
+				hold.start.ID = startNote.ID;
+				hold.start.ease = step.ease;
+				hold.startType = HoldNoteType::Guide;
+			}
+			else if (i == midpoints.size() - 1)
+			{
+				Note endNote(NoteType::HoldEnd);
+				setPosition(endNote, step);
+				endNote.ID = score.allocateNoteID();
+				endNote.parentID = hold.start.ID;
+				score.notes[endNote.ID] = endNote;
+				hold.end = endNote.ID;
+				hold.endType = HoldNoteType::Guide;
+			}
+			else
+			{
+				Note mid(NoteType::HoldMid);
+				setPosition(mid, step);
+				mid.ID = score.allocateNoteID();
+				mid.parentID = hold.start.ID;
+				score.notes[mid.ID] = mid;
+				hold.steps.push_back(HoldStep{ mid.ID, HoldStepType::Hidden, step.ease });
+			}
+		}
+		score.holdNotes[hold.start.ID] = hold;
+	}
+
+	void UscParser::addSlide()
+	{
+		HoldNote hold;
+		hold.fadeType = FadeType::None;
+
+		// The start comes first and the end last, other connections are ordered by beat
+		std::vector<UscValues>& connections = object.children;
+		std::stable_sort(connections.begin(), connections.end(),
+		                 [](const UscValues& a, const UscValues& b)
+		                 {
+			                 if (a.stepType == UscStepType::Start)
+				                 return true;
+			                 else if (b.stepType == UscStepType::Start)
+				                 return false;
+			                 else if (a.stepType == UscStepType::End)
+				                 return false;
+			                 else if (b.stepType == UscStepType::End)
+				                 return true;
+
+			                 return a.beat < static_cast<float>(b.beat);
+		                 });
+
+		bool isCritical = false;
+		for (const UscValues& step : connections)
+		{
+			if (step.stepType == UscStepType::Start)
+			{
+				Note startNote(NoteType::Hold);
+				setPosition(startNote, step);
+				startNote.critical = step.critical;
+				isCritical = startNote.critical;
+				startNote.friction = step.judgeType == UscJudgeType::Trace;
+				hold.startType = step.judgeType == UscJudgeType::None ? HoldNoteType::Hidden
+				                                                      : HoldNoteType::Normal;
+				startNote.ID = score.allocateNoteID();
+				score.notes[startNote.ID] = startNote;
+				hold.start.ID = startNote.ID;
+				hold.start.ease = step.ease;
+			}
+			else if (step.stepType == UscStepType::End)
+			{
+				Note endNote(NoteType::HoldEnd);
+				setPosition(endNote, step);
+				endNote.critical = isCritical || step.critical;
+				endNote.flick = step.flick;
+				endNote.ID = score.allocateNoteID();
+				endNote.parentID = hold.start.ID;
+				endNote.friction = step.judgeType == UscJudgeType::Trace;
+				hold.endType = step.judgeType == UscJudgeType::None ? HoldNoteType::Hidden
+				                                                    : HoldNoteType::Normal;
+				score.notes[endNote.ID] = endNote;
+				hold.end = endNote.ID;
+			}
+			else
+			{
+				Note mid(NoteType::HoldMid);
+				setPosition(mid, step);
+				mid.critical = isCritical;
+				mid.ID = score.allocateNoteID();
+				mid.parentID = hold.start.ID;
+				score.notes[mid.ID] = mid;
+
+				HoldStep s{ mid.ID, HoldStepType::Normal, step.ease };
+				if (step.stepType == UscStepType::Tick)
+					s.type = step.hasCritical ? HoldStepType::Normal : HoldStepType::Hidden;
+				else if (step.stepType == UscStepType::Attach)
+					s.type = HoldStepType::Skip;
+
+				hold.steps.push_back(s);
+			}
+		}
+
+		score.holdNotes[hold.start.ID] = hold;
+	}
+
+	Score UscParser::parse(const std::string& filename)
+	{
+		// The stream is only at its end here if the file could not be opened
+		IO::File uscFile(IO::mbToWideStr(filename), L"rb");
+		std::string text = uscFile.isEndofFile() ? "" : uscFile.readAllText();
+		uscFile.close();
+
+		score = Score();
+		score.layers.clear();
+		score.hiSpeedChanges.clear();
+		score.tempoChanges.clear();
+		contexts.clear();
+		currentKey = UscKey::Unknown;
+		version = 0;
+
+		nlohmann::json::sax_parse(text, this);
+		if (version != 2)
+			throw std::runtime_error("Invalid version");
+
+		if (score.layers.size() == 0)
+			score.layers.push_back(Layer{ "#0" });
+
+		if (score.tempoChanges.size() == 0)
+			score.tempoChanges.push_back(Tempo{ 0, 120 });
+
+		return std::move(score);
+	}
+
+	bool UscParser::null()
+	{
+		return true;
+	}
+
+	bool UscParser::boolean(bool value)
+	{
+		if (UscValues* values = currentValues())
+		{
+			if (currentKey == UscKey::Critical)
+				values->critical = value;
+			else if (currentKey == UscKey::Trace)
+				values->trace = value;
+		}
+
+		return true;
+	}
+
+	bool UscParser::number_integer(nlohmann::json::number_integer_t value)
+	{
+		setNumber(value);
+		return true;
+	}
+
+	bool UscParser::number_unsigned(nlohmann::json::number_unsigned_t value)
+	{
+		setNumber(value);
+		return true;
+	}
+
+	bool UscParser::number_float(nlohmann::json::number_float_t value, const std::string& raw)
+	{
+		setNumber(value);
+		return true;
+	}
+
+	bool UscParser::string(std::string& value)
+	{
+		UscValues* values = currentValues();
+		if (!values)
+			return true;
+
+		switch (currentKey)
+		{
+		case UscKey::Type:
+			if (contexts.back() == Context::Object)
+				values->objectType = objectTypeNames.find(value, UscObjectType::Unknown);
+			else
+				values->stepType = stepTypeNames.find(value, UscStepType::Unknown);
+			break;
+		case UscKey::Ease:
+			values->ease = easeTypeNames.find(value, EaseType::Linear);
+			break;
+		case UscKey::Color:
+			values->color = guideColorNames.find(value, GuideColor::Green);
+			break;
+		case UscKey::Fade:
+			values->fade = fadeTypeNames.find(value, FadeType::Out);
+			break;
+		case UscKey::Direction:
+			values->flick = flickTypeNames.find(value, FlickType::Right);
+			break;
+		case UscKey::JudgeType:
+			values->judgeType = judgeTypeNames.find(value, UscJudgeType::Normal);
+			break;
+		default:
+			break;
+		}
+
+		return true;
+	}
+
+	bool UscParser::binary(nlohmann::json::binary_t& value)
+	{
+		return true;
+	}
+
+	bool UscParser::start_object(std::size_t elements)
+	{
+		return beginContainer(false);
+	}
+
+	bool UscParser::end_object()
+	{
+		return endContainer();
+	}
+
+	bool UscParser::start_array(std::size_t elements)
+	{
+		return beginContainer(true);
+	}
+
+	bool UscParser::end_array()
+	{
+		return endContainer();
+	}
+
+	bool UscParser::key(std::string& value)
+	{
+		currentKey = keyNames.find(value, UscKey::Unknown);
+
+		// A step with a critical field is a visible tick whatever its value
+		if (currentKey == UscKey::Critical)
+		{
+			if (UscValues* values = currentValues())
+				values->hasCritical = true;
+		}
+
+		return true;
+	}
+
+	bool UscParser::parse_error(std::size_t position, const std::string& lastToken,
+	                            const nlohmann::detail::exception& ex)
+	{
+		throw std::runtime_error(ex.what());
+	}
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include "Score.h"
+#include <json.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MikuMikuWorld
+{
+	enum class UscKey : uint8_t
+	{
+		Unknown,
+		Version,
+		Usc,
+		Offset,
+		Objects,
+		Type,
+		Beat,
+		Bpm,
+		Size,
+		Lane,
+		Critical,
+		Trace,
+		Direction,
+		TimeScaleGroup,
+		TimeScale,
+		Color,
+		Fade,
+		Ease,
+		JudgeType,
+		Changes,
+		Midpoints,
+		Connections
+	};
+
+	enum class UscObjectType : uint8_t
+	{
+		Unknown,
+		Bpm,
+		TimeScaleGroup,
+		Single,
+		Damage,
+		Guide,
+		Slide
+	};
+
+	enum class UscStepType : uint8_t
+	{
+		Unknown,
+		Start,
+		End,
+		Tick,
+		Attach
+	};
+
+	enum class UscJudgeType : uint8_t
+	{
+		Normal,
+		Trace,
+		None
+	};
+
+	// The fields of an object, hi-speed change or hold step. Enum strings are decoded as they
+	// are read and missing fields keep their defaults
+	struct UscValues
+	{
+		double beat{};
+		float bpm{};
+		float lane{};
+		float size{};
+		float timeScale{};
+		int layer{};
+		bool critical{};
+		bool hasCritical{};
+		bool trace{};
+		FlickType flick{ FlickType::None };
+		EaseType ease{ EaseType::Linear };
+		GuideColor color{ GuideColor::Green };
+		FadeType fade{ FadeType::Out };
+		UscJudgeType judgeType{ UscJudgeType::Normal };
+		UscObjectType objectType{ UscObjectType::Unknown };
+		UscStepType stepType{ UscStepType::Unknown };
+	};
+
+	struct UscObject
+	{
+		UscValues values;
+
+		// Hi-speed changes, guide midpoints or slide connections depending on the type
+		std::vector<UscValues> children;
+	};
+
+	// Builds a score from the JSON parse events of a .usc file. Objects are added to the score
+	// as soon as they end so the document is never held in memory
+	class UscParser
+	{
+	  private:
+		enum class Context : uint8_t
+		{
+			Root,
+			Usc,
+			Objects,
+			Object,
+			Children,
+			Child,
+			Skip
+		};
+
+		Score score;
+		std::vector<Context> contexts;
+		UscObject object;
+		UscKey currentKey{ UscKey::Unknown };
+		double version{};
+
+		UscValues* currentValues();
+		bool beginContainer(bool isArray);
+		bool endContainer();
+		void setNumber(double value);
+
+		void addObject();
+		void addGuide();
+		void addSlide();
+
+	  public:
+		Score parse(const std::string& filename);
+
+		// Parse event handlers called by nlohmann::json::sax_parse
+		bool null();
+		bool boolean(bool value);
+		bool number_integer(nlohmann::json::number_integer_t value);
+		bool number_unsigned(nlohmann::json::number_unsigned_t value);
+		bool number_float(nlohmann::json::number_float_t value, const std::string& raw);
+		bool string(std::string& value);
+		bool binary(nlohmann::json::binary_t& value);
+		bool start_object(std::size_t elements);
+		bool end_object();
+		bool start_array(std::size_t elements);
+		bool end_array();
+		bool key(std::string& value);
+		bool parse_error(std::size_t position, const std::string& lastToken,
+		                 const nlohmann::detail::exception& ex);
+	};
+}
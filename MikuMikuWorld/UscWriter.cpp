@@ -0,0 +1,326 @@
+#include "UscWriter.h"
+#include "Constants.h"
+#include "File.h"
+#include "IO.h"
+#include "Score.h"
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cmath>
+#include <json.hpp>
+#include <tuple>
+
+namespace MikuMikuWorld
+{
+	// The buffer is written out once it grows past this size
+	constexpr size_t uscFlushSize = 64 * 1024;
+
+	static const char* flickName(FlickType flick)
+	{
+		return flick == FlickType::Default ? "up" : flick == FlickType::Left ? "left" : "right";
+	}
+
+	static const char* judgeTypeName(HoldNoteType type, const Note& note)
+	{
+		return type == HoldNoteType::Hidden ? "none" : note.friction ? "trace" : "normal";
+	}
+
+	void UscWriter::beginValue()
+	{
+		if (afterKey)
+		{
+			afterKey = false;
+			return;
+		}
+
+		if (containers.empty())
+			return;
+
+		Container& container = containers.back();
+		buffer += container.empty ? "\n" : ",\n";
+		buffer.append(containers.size() * 4, ' ');
+		container.empty = false;
+	}
+
+	void UscWriter::beginContainer(char open, char close)
+	{
+		beginValue();
+		buffer += open;
+		containers.push_back({ close, true });
+	}
+
+	void UscWriter::endContainer()
+	{
+		Container container = containers.back();
+		containers.pop_back();
+		if (!container.empty)
+		{
+			buffer += '\n';
+			buffer.append(containers.size() * 4, ' ');
+		}
+
+		buffer += container.close;
+	}
+
+	void UscWriter::key(const char* name)
+	{
+		beginValue();
+		buffer += '"';
+		buffer += name;
+		buffer += "\": ";
+		afterKey = true;
+	}
+
+	// Values are fixed names that never need escaping
+	void UscWriter::field(const char* name, const char* value)
+	{
+		key(name);
+		beginValue();
+		buffer += '"';
+		buffer += value;
+		buffer += '"';
+	}
+
+	void UscWriter::field(const char* name, double value)
+	{
+		key(name);
+		beginValue();
+
+		// Formatted the same way as nlohmann::json so values read back exactly, including
+		// writing null for values JSON can't represent
+		if (!std::isfinite(value))
+		{
+			buffer += "null";
+			return;
+		}
+
+		std::array<char, 64> number{};
+		char* end =
+		    nlohmann::detail::to_chars(number.data(), number.data() + number.size(), value);
+
+		buffer.append(number.data(), end);
+	}
+
+	void UscWriter::field(const char* name, int value)
+	{
+		key(name);
+		beginValue();
+		buffer += std::to_string(value);
+	}
+
+	void UscWriter::field(const char* name, bool value)
+	{
+		key(name);
+		beginValue();
+		buffer += value ? "true" : "false";
+	}
+
+	void UscWriter::flushIfFull()
+	{
+		if (file && buffer.size() >= uscFlushSize)
+		{
+			file->write(buffer);
+			buffer.clear();
+		}
+	}
+
+	void UscWriter::writeNote(const Note& note, const char* type)
+	{
+		beginContainer('{', '}');
+		field("beat", note.tick / (double)TICKS_PER_BEAT);
+		if (note.getType() == NoteType::Tap)
+		{
+			field("critical", note.critical);
+			if (note.flick != FlickType::None)
+				field("direction", flickName(note.flick));
+		}
+
+		field("lane", note.lane - 6 + (note.width / 2.0));
+		field("size", note.width / 2.0);
+		field("timeScaleGroup", note.layer);
+		if (note.getType() == NoteType::Tap)
+			field("trace", note.friction);
+
+		field("type", type);
+		endContainer();
+	}
+
+	void UscWriter::writeHold(const Score& score, int id)
+	{
+		const HoldNote& hold = score.holdNotes.at(id);
+		const Note& start = score.notes.at(hold.start.ID);
+		const Note& end = score.notes.at(hold.end);
+
+		beginContainer('{', '}');
+		if (hold.isGuide())
+		{
+			field("color", guideColors[(int)hold.guideColor]);
+			field("fade", hold.fadeType == FadeType::None ? "none"
+			              : hold.fadeType == FadeType::In ? "in"
+			                                              : "out");
+
+			key("midpoints");
+			beginContainer('[', ']');
+			auto writeMidpoint = [this](const Note& note, EaseType ease)
+			{
+				beginContainer('{', '}');
+				field("beat", note.tick / (double)TICKS_PER_BEAT);
+				field("ease", easeNames[(int)ease]);
+				field("lane", note.lane - 6 + (note.width / 2.0));
+				field("size", note.width / 2.0);
+				field("timeScaleGroup", note.layer);
+				endContainer();
+			};
+
+			writeMidpoint(start, hold.start.ease);
+			for (const HoldStep& step : hold.steps)
+				writeMidpoint(score.notes.at(step.ID), step.ease);
+
+			writeMidpoint(end, EaseType::Linear);
+			endContainer();
+
+			field("type", "guide");
+			endContainer();
+			return;
+		}
+
+		key("connections");
+		beginContainer('[', ']');
+
+		beginContainer('{', '}');
+		field("beat", start.tick / (double)TICKS_PER_BEAT);
+		field("critical", start.critical);
+		field("ease", easeNames[(int)hold.start.ease]);
+		field("judgeType", judgeTypeName(hold.startType, start));
+		field("lane", start.lane - 6 + (start.width / 2.0));
+		field("size", start.width / 2.0);
+		field("timeScaleGroup", start.layer);
+		field("type", "start");
+		endContainer();
+
+		for (const HoldStep& step : hold.steps)
+		{
+			const Note& stepNote = score.notes.at(step.ID);
+			beginContainer('{', '}');
+			field("beat", stepNote.tick / (double)TICKS_PER_BEAT);
+			if (step.type != HoldStepType::Hidden)
+				field("critical", stepNote.critical);
+
+			field("ease", easeNames[(int)step.ease]);
+			field("lane", stepNote.lane - 6 + (stepNote.width / 2.0));
+			field("size", stepNote.width / 2.0);
+			field("timeScaleGroup", stepNote.layer);
+			field("type", step.type == HoldStepType::Skip ? "attach" : "tick");
+			endContainer();
+		}
+
+		beginContainer('{', '}');
+		field("beat", end.tick / (double)TICKS_PER_BEAT);
+		field("critical", end.critical);
+		if (end.flick != FlickType::None)
+			field("direction", flickName(end.flick));
+
+		field("judgeType", judgeTypeName(hold.endType, end));
+		field("lane", end.lane - 6 + (end.width / 2.0));
+		field("size", end.width / 2.0);
+		field("timeScaleGroup", end.layer);
+		field("type", "end");
+		endContainer();
+
+		endContainer();
+		field("critical", start.critical);
+		field("type", "slide");
+		endContainer();
+	}
+
+	void UscWriter::writeScore(const Score& score)
+	{
+		containers.clear();
+		afterKey = false;
+
+		beginContainer('{', '}');
+		key("usc");
+		beginContainer('{', '}');
+		key("objects");
+		beginContainer('[', ']');
+
+		for (const Tempo& tempo : score.tempoChanges)
+		{
+			beginContainer('{', '}');
+			field("beat", tempo.tick / (double)TICKS_PER_BEAT);
+			field("bpm", tempo.bpm);
+			field("type", "bpm");
+			endContainer();
+		}
+
+		for (int layer = 0; layer < score.layers.size(); ++layer)
+		{
+			// Changes at the same tick are ordered by speed so the output does not depend on IDs
+			std::vector<const HiSpeedChange*> changes;
+			for (int id : score.hiSpeedChangesInTickRange(INT_MIN, INT_MAX, layer))
+				changes.push_back(&score.hiSpeedChanges.at(id));
+
+			std::stable_sort(changes.begin(), changes.end(),
+			                 [](const HiSpeedChange* a, const HiSpeedChange* b)
+			                 { return std::tie(a->tick, a->speed) < std::tie(b->tick, b->speed); });
+
+			beginContainer('{', '}');
+			key("changes");
+			beginContainer('[', ']');
+			for (const HiSpeedChange* change : changes)
+			{
+				beginContainer('{', '}');
+				field("beat", change->tick / (double)TICKS_PER_BEAT);
+				field("timeScale", change->speed);
+				endContainer();
+			}
+			endContainer();
+			field("type", "timeScaleGroup");
+			endContainer();
+			flushIfFull();
+		}
+
+		for (int id : canonicalNoteOrder(score))
+		{
+			const Note& note = score.notes.at(id);
+			writeNote(note, note.getType() == NoteType::Tap ? "single" : "damage");
+			flushIfFull();
+		}
+
+		for (int id : canonicalHoldOrder(score))
+		{
+			writeHold(score, id);
+			flushIfFull();
+		}
+
+		endContainer();
+		field("offset", score.metadata.musicOffset / -1000.0f);
+		endContainer();
+		field("version", 2);
+		endContainer();
+	}
+
+	void UscWriter::write(const Score& score, const std::string& filename)
+	{
+		IO::File uscFile(IO::mbToWideStr(filename), L"w");
+		file = &uscFile;
+		buffer.clear();
+		buffer.reserve(uscFlushSize * 2);
+
+		writeScore(score);
+		uscFile.write(buffer);
+		uscFile.flush();
+		uscFile.close();
+
+		file = nullptr;
+		buffer.clear();
+	}
+
+	std::string UscWriter::write(const Score& score)
+	{
+		file = nullptr;
+		buffer.clear();
+		writeScore(score);
+		return std::move(buffer);
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace IO
+{
+	class File;
+}
+
+namespace MikuMikuWorld
+{
+	struct Score;
+	class Note;
+
+	// Writes a score as USC v2 JSON in a single pass without building a document. Objects
+	// are written in the canonical save order and their keys in alphabetical order, the same
+	// layout nlohmann::json::dump(4) uses
+	class UscWriter
+	{
+	  private:
+		struct Container
+		{
+			char close;
+			bool empty;
+		};
+
+		std::string buffer;
+		std::vector<Container> containers;
+		IO::File* file{};
+		bool afterKey{};
+
+		void beginValue();
+		void beginContainer(char open, char close);
+		void endContainer();
+		void key(const char* name);
+		void field(const char* name, const char* value);
+		void field(const char* name, double value);
+		void field(const char* name, int value);
+		void field(const char* name, bool value);
+		void flushIfFull();
+
+		void writeScore(const Score& score);
+		void writeNote(const Note& note, const char* type);
+		void writeHold(const Score& score, int id);
+
+	  public:
+		// Writes to the file in blocks so only a small part of the output is held in memory
+		void write(const Score& score, const std::string& filename);
+
+		std::string write(const Score& score);
+	};
+}